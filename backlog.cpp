@@ -0,0 +1,36 @@
+#include "backlog.h"
+#include "messages.h"
+
+namespace Network
+{
+	void SnapshotBacklog::Push(const WorldSnapshot& snapshot)
+	{
+		mSnapshots.push_back(snapshot);
+		mIsPacketValid = false;
+
+		// Keep the newest snapshot that is at least mLength old as the keyframe
+		while (mSnapshots.size() > 2 && snapshot.serverTime - mSnapshots[1].serverTime >= (sf::Uint64) us(mLength).count())
+			mSnapshots.pop_front();
+	}
+
+	SharedPacket& SnapshotBacklog::GetPacket()
+	{
+		if (mIsPacketValid)
+			return mPacket;
+
+		// Only the players are needed to interpolate, so only the newest snapshot carries bullets
+		Message<PACKET_SERVER_BACKLOG> msg;
+		msg.snapshots.reserve(mSnapshots.size());
+		for (const auto& snapshot : mSnapshots)
+		{
+			WorldSnapshot entry;
+			entry.serverTime = snapshot.serverTime;
+			entry.snapshot = (&snapshot == &mSnapshots.back()) ? snapshot.snapshot : snapshot.snapshot.WithBullets({});
+			msg.snapshots.push_back(entry);
+		}
+
+		mPacket = SharedPacket(Encode(msg));
+		mIsPacketValid = true;
+		return mPacket;
+	}
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <deque>
+#include "network.h"
+#include "world.h"
+
+// backlog.h: Recent history of the game, so spectators that have just joined can interpolate straight away
+
+namespace Network
+{
+	class SnapshotBacklog
+	{
+	public:
+		explicit SnapshotBacklog(ms length) : mLength(length) {}
+
+		void Push(const WorldSnapshot& snapshot);
+
+		// PACKET_SERVER_BACKLOG holding the backlog; encoded (and compressed) at most once between pushes
+		SharedPacket& GetPacket();
+
+		bool IsEmpty() const { return mSnapshots.empty(); }
+		std::size_t GetSize() const { return mSnapshots.size(); }
+
+	private:
+		ms mLength;
+		std::deque<WorldSnapshot> mSnapshots;
+
+		SharedPacket mPacket;
+		bool mIsPacketValid = false;
+	};
+}
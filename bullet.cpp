@@ -1,19 +1,25 @@
 #include "bullet.h"
-#include "network.h"
+#include <cstring>
+#include "common.h"
 
 void Bullet::Update(sf::Uint64 dt)
 {
-	mPosition += mDirection * BULLET_SPEED * (dt / 1000.f);
+	mPosition += mDirection * DistanceIn(BULLET_SPEED, ms(dt));
 }
 
-sf::Packet& operator<<(sf::Packet& p, const Bullet& b)
+sf::Uint32 Bullet::GetChecksum() const
 {
-	p << b.mID << b.mColour << b.mDirection << b.mPosition;
-	return p;
-}
+	// The bits of the direction, whichever type Scalar is
+	static_assert(sizeof(Scalar) == sizeof(sf::Uint32), "Scalar is expected to be 32 bits");
+	sf::Uint32 dx, dy;
+	std::memcpy(&dx, &mDirection.x, sizeof(dx));
+	std::memcpy(&dy, &mDirection.y, sizeof(dy));
 
-sf::Packet& operator >> (sf::Packet& p, Bullet& b)
-{
-	p >> b.mID >> b.mColour >> b.mDirection >> b.mPosition;
-	return p;
+	// splitmix64's finaliser, folded to 32 bits
+	sf::Uint64 h = (sf::Uint64(mID) << 32) ^ mColour ^ (sf::Uint64(dx) << 16) ^ (sf::Uint64(dy) << 48);
+	h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;
+	h = (h ^ (h >> 27)) * 0x94D049BB133111EBull;
+	h ^= h >> 31;
+
+	return sf::Uint32(h ^ (h >> 32));
 }
@@ -1,39 +1,37 @@
 #pragma once
 #include <SFML/System.hpp>
+#include <tuple>
+#include "fixed.h"
+#include "slot_map.h"
 
 // bullet.h: Represents a bullet (a lot in common with Player. Should have used polymorphism)
 
-namespace sf
-{
-	class Packet;
-}
-
 class Bullet
 {
 public:
-	friend sf::Packet& operator<<(sf::Packet& p, const Bullet& b);
-	friend sf::Packet& operator>>(sf::Packet& p, Bullet& b);
+	constexpr static Scalar BULLET_SPEED{ 400.f };
 
-	constexpr static float BULLET_SPEED = 400.f;
+	// Wire layout (protocol.h)
+	static constexpr auto Fields() { return std::make_tuple(&Bullet::mID, &Bullet::mColour, &Bullet::mDirection, &Bullet::mPosition); }
 
 	void Update(sf::Uint64 dt);
 
-	void SetID(sf::Uint32 id) { mID = id; }
+	// Hash of what stays the same over the bullet's life; where it is follows from when it was fired
+	sf::Uint32 GetChecksum() const;
+
+	void SetID(EntityID id) { mID = id; }
 	void SetColour(sf::Uint32 colour) { mColour = colour; }
-	void SetDirection(const sf::Vector2f& direction) { mDirection = direction; }
-	void SetPosition(const sf::Vector2f& position) { mPosition = position; }
+	void SetDirection(const Vector& direction) { mDirection = direction; }
+	void SetPosition(const Vector& position) { mPosition = position; }
 	
-	sf::Uint32 GetID() const { return mID; }
+	EntityID GetID() const { return mID; }
 	sf::Uint32 GetColour() const { return mColour; }
-	sf::Vector2f GetDirection() const { return mDirection; }
-	sf::Vector2f GetPosition() const { return mPosition; }
+	Vector GetDirection() const { return mDirection; }
+	Vector GetPosition() const { return mPosition; }
 
 private:
-	sf::Uint32 mID;
+	EntityID mID;
 	sf::Uint32 mColour;
-	sf::Vector2f mDirection;
-	sf::Vector2f mPosition;
+	Vector mDirection;
+	Vector mPosition;
 };
-
-sf::Packet& operator<<(sf::Packet& p, const Bullet& b);
-sf::Packet& operator>>(sf::Packet& p, Bullet& b);
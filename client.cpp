@@ -1,10 +1,14 @@
 #include "client.h"
+#include <deque>
 #include <list>
-#include <functional>
-#include <SFML/Graphics.hpp>
+#include <map>
+#include <algorithm>
+#include <cmath>
 #include <iomanip>
-#include "world.h"
-#include "command.h"
+#include "messages.h"
+#include "jitter_buffer.h"
+#include "frame_pacer.h"
+#include "render.h"
 #include "common.h"
 #include "debug.h"
 
@@ -13,7 +17,36 @@ namespace Network
 		namespace Client
 		{
 				// Global variables ///////
-				constexpr int INTERPOLATION_TIME_MS = 150;
+
+				// How long remote players keep moving on their own when updates stop coming in
+				constexpr int EXTRAPOLATION_LIMIT_MS = 250;
+
+				// How quickly a remote player's position is corrected once updates come in again
+				constexpr float CONVERGENCE_TIME_MS = 100.f;
+
+				// Time between our input latencies going to the log
+				constexpr int LATENCY_REPORT_INTERVAL_MS = 10000;
+
+				// Commands the server has not acknowledged yet, beyond which the oldest are no longer timed
+				constexpr std::size_t MAX_TIMED_INPUTS = 1024;
+
+				// How long a bullet takes to cross the screen; one fired longer ago than that has left it
+				constexpr sf::Uint64 BULLET_LIFETIME_US = sf::Uint64((VP_HEIGHT + BULLET_H) / float(Bullet::BULLET_SPEED) * 1000000.f);
+
+				// Input is sampled, and our own simulation (prediction and bullets) stepped, this often, whatever the frame rate
+				// A whole number of milliseconds, since that is what commands carry their dt in, so every command's is the same
+				constexpr int SIMULATION_STEP_MS = 16;
+
+				// The most steps run in one frame; after a longer stall the rest of the time is dropped (see FramePacer)
+				constexpr int MAX_STEPS_PER_FRAME = 5;
+
+				// How far the server may put us from where we predicted before our pending commands are replayed
+				// (fixed-point prediction is exact, so there any difference at all is a misprediction)
+#ifdef NETWORKING_DETERMINISTIC
+				constexpr float MISPREDICTION_TOLERANCE = 0.f;
+#else
+				constexpr float MISPREDICTION_TOLERANCE = 0.01f;
+#endif
 
 				// Networking
 				Connection gConnection;
@@ -22,36 +55,92 @@ namespace Network
 				bool gIsPredicting = true;
 				bool gIsReconciling = true;
 				bool gIsInterpolating = true;
+				bool gIsExtrapolating = true;
 				bool gShowServerBullets = false;
 
 				// Graphics
 				std::unique_ptr<sf::RenderWindow> gWindow;
 
 				// Game
-				ms gElapsedTime;
+				// Time since the client started; the server's clock is estimated from it by gConnection.clock
+				time_point gStartTime;
+				us gElapsedTime;
 
-				sf::Uint8 gMyID;
+				EntityID gMyID = INVALID_ENTITY;
 				World gWorld;
 
-				std::list<Command> gCommands;
+				// Simulation steps are drawn blended between the world before the last step and after it
+				FramePacer gPacer{ ms(SIMULATION_STEP_MS), MAX_STEPS_PER_FRAME };
+				World gPreviousWorld;
+
+				// A command we ran ahead of the server, and where it left us; oldest first
+				struct Prediction
+				{
+						Command cmd;
+						Vector position;
+				};
+
+				std::deque<Prediction> gPredictions;
 				std::list<WorldSnapshot> gSnapshots;
 
 				bool gViewInverted = false;
 
+				// How far in the past we render other entities; adapts to how regularly updates arrive
+				JitterBuffer gJitterBuffer;
+
 				struct FutureBullet
 				{
 						sf::Uint64 serverTime;
 						Bullet bullet;
 				};
 
+				// How remote players were last seen moving, for when we have to extrapolate
+				struct RemoteMotion
+				{
+						sf::Vector2f velocity;		// Per microsecond, between the last two snapshots we interpolated between
+						sf::Vector2f shown;			// Where the player was drawn last frame
+						sf::Vector2f error;			// Left over from extrapolating, made up over CONVERGENCE_TIME_MS
+						bool isPlaced = false;		// Interpolated or extrapolated this frame, so the error can be added to where that put them
+				};
+
+				std::map<EntityID, RemoteMotion> gRemoteMotion;
+				bool gWasExtrapolating = false;
+
 				// Cache of bullets the server has told us about, but we are not
 				// ready to show yet because of interpolation
 				std::vector<FutureBullet> gIncomingBullets;
 
+				// Bullets we fired and predicted, by the spawn token we sent with them (see World::PredictShot)
+				std::map<sf::Uint32, EntityID> gPredictedShots;
+				sf::Uint32 gNextSpawnToken = 0;
+
+				// A command we sent, and when it was input (on our clock)
+				struct TimedInput
+				{
+						sf::Uint32 id;
+						sf::Uint64 inputTime;
+				};
+
+				// Inputs are timed from when they are input to when the server's state acknowledges them (see Player::GetLastCommandID),
+				// and in two hops: to the server, until the snapshot that acknowledges them, and back from that snapshot to us
+				std::deque<TimedInput> gTimedInputs;
+				LatencyHistogram gInputLatency;
+				LatencyHistogram gToServerLatency;
+				LatencyHistogram gFromServerLatency;
+				us gNextLatencyReport{ ms(LATENCY_REPORT_INTERVAL_MS) };
+
+				// Times our bullets stopped matching the server's checksum (see CAPABILITY_CHECKSUMS),
+				// and whether we are still waiting for the server to send them all again
+				sf::Uint32 gDesyncs = 0;
+				bool gIsResyncing = false;
+
 				// Forward declarations
 				void InitializeWindow(const char* title);
+				sf::Uint64 GetClockTime();
+				sf::Uint64 GetServerTime();
 				sf::Uint64 GetRenderTime();
 				void DeleteOldSnapshots(sf::Uint64 renderTime);
+				bool DispatchPacket(const sf::Uint8* data, std::size_t size);
 
 				// SEND FUNCTIONS //////////////////////////////////
 
@@ -62,10 +151,11 @@ namespace Network
 						if (gConnection.status != STATUS_NONE)
 								return;
 
-						auto p = InitPacket(PACKET_CLIENT_JOIN);
+						Message<PACKET_CLIENT_JOIN> msg;
+						msg.capabilities = sf::Uint8(CAPABILITY_COMPRESSION_V2 | CAPABILITY_SPAWN_TOKENS | CAPABILITY_CHECKSUMS | CAPABILITY_INPUT_TIMES);
 
 						debug << "CLIENT: Sent join request to server" << std::endl;
-						gConnection.Send(p);
+						gConnection.Send(msg);
 						gConnection.status = STATUS_JOINING;
 				}
 
@@ -77,25 +167,48 @@ namespace Network
 						if (gConnection.status != STATUS_PLAYING)
 								return;
 
-						auto p = InitPacket(PACKET_CLIENT_CMD);
-						p << cmd;
+						Message<PACKET_CLIENT_CMD> msg;
+						msg.cmd = cmd;
+
+						sf::Uint64 now = GetClockTime();
+						if (gConnection.Accepts(CAPABILITY_INPUT_TIMES) && gConnection.clock.IsSynchronised())
+								msg.inputTime = gConnection.clock.ToRemote(now);
 
-						gConnection.Send(p);
+						gConnection.Send(msg);
+
+						gTimedInputs.push_back({ cmd.id, now });
+						if (gTimedInputs.size() > MAX_TIMED_INPUTS)
+								gTimedInputs.pop_front();
 				}
 
 				DEF_SEND_PARAM(PACKET_CLIENT_PING)(sf::Uint64 serverTime)
 				{
 						//// Respond to the server's ping request
 						// serverTime: The server's timestamp
-						// gElapsedTime.count(): The client's timestamp (server will be responding to us as well)
+						// GetClockTime(): The client's timestamp (server will be responding to us with its clock)
 
 						if (gConnection.status != STATUS_PLAYING && gConnection.status != STATUS_SPECTATING)
 								return;
 
-						auto p = InitPacket(PACKET_CLIENT_PING);
-						p << sf::Uint64(serverTime) << sf::Uint64(gElapsedTime.count());
+						Message<PACKET_CLIENT_PING> msg;
+						msg.serverTime = serverTime;
+						msg.clientTime = GetClockTime();
 
-						gConnection.Send(p);
+						gConnection.Send(msg);
+				}
+
+				DEF_SEND_PARAM(PACKET_CLIENT_ACK)(sf::Uint64 serverTime)
+				{
+						//// Acknowledge a state update, so the server can tell how well our connection keeps up
+						// serverTime: The snapshot's timestamp
+
+						if (gConnection.status != STATUS_PLAYING && gConnection.status != STATUS_SPECTATING)
+								return;
+
+						Message<PACKET_CLIENT_ACK> msg;
+						msg.serverTime = serverTime;
+
+						gConnection.Send(msg);
 				}
 
 				DEF_CLIENT_SEND(PACKET_CLIENT_SHOOT)
@@ -106,16 +219,48 @@ namespace Network
 						if (gConnection.status != STATUS_PLAYING)
 								return;
 
-						auto p = InitPacket(PACKET_CLIENT_SHOOT);
+						// The server rewinds to when we fired, so it spawns the bullet where we see it
+						Message<PACKET_CLIENT_SHOOT> msg;
+						msg.serverTime = GetServerTime();
+
+						// The server sends the token back with its own bullet, which then takes the place of ours
+						if (gConnection.Accepts(CAPABILITY_SPAWN_TOKENS))
+						{
+								Bullet predicted = gWorld.PredictShot(gMyID);
+
+								msg.spawnToken = gNextSpawnToken;
+								gPredictedShots[gNextSpawnToken++] = predicted.GetID();
+						}
+						else
+								gWorld.PlayerShoot(gMyID);
+
+						gConnection.Send(msg);
+				}
+
+				DEF_CLIENT_SEND(PACKET_CLIENT_RESYNC)
+				{
+						//// Ask the server for every bullet, since ours no longer match its checksum
 
-						gWorld.PlayerShoot(gMyID);
-						gConnection.Send(p);
+						if (gConnection.status != STATUS_PLAYING)
+								return;
+
+						Message<PACKET_CLIENT_RESYNC> msg;
+						gConnection.Send(msg);
 				}
 
 				// RECEIVE FUNCTIONS ///////////////////////////////
 				// If any of the receive functions return false,
 				// the client will disconnect.
 
+				// Every packet type sent to the client needs a DEF_CLIENT_RECV specialisation,
+				// the dispatch table below will not compile otherwise
+				template<PacketType TYPE>
+				bool Receive(const Message<TYPE>& p)
+				{
+						static_assert(NO_HANDLER<TYPE>, "Missing client receive function for packet type");
+						return false;
+				}
+
 				DEF_CLIENT_RECV(PACKET_SERVER_WELCOME)
 				{
 						//// The server has accepted us as a player
@@ -125,13 +270,14 @@ namespace Network
 						if (gConnection.status != STATUS_JOINING)
 								return true;
 
-						float viewRotation;
-						p >> gMyID >> viewRotation;
+						gMyID = p.pid;
+						float viewRotation = p.rotation;
+						gConnection.capabilities = p.capabilities;
 
-						debug << "CLIENT: Server assigned us id #" << (int) gMyID << std::endl;
+						debug << "CLIENT: Server assigned us id #" << gMyID << std::endl;
 
 						char title[32];
-						sprintf(title, "Client #%d", gMyID);
+						sprintf(title, "Client #%u", (unsigned) gMyID);
 						InitializeWindow(title);
 
 						// Rotate our view so that we appear on the bottom
@@ -159,6 +305,7 @@ namespace Network
 
 						InitializeWindow("Spectating");
 
+						gConnection.capabilities = p.capabilities;
 						gConnection.status = STATUS_SPECTATING;
 						return true;
 				}
@@ -170,31 +317,38 @@ namespace Network
 						if (gConnection.status != STATUS_JOINING)
 								return true;
 
-						debug << "CLIENT: Could not join server because it is full" << std::endl;
+						debug << "CLIENT: Could not join server because it is full (or speaks another protocol version)" << std::endl;
 
 						return false;
 				}
 
 				DEF_CLIENT_RECV(PACKET_SERVER_PING)
 				{
-						//// The server has requested or responded to a ping request
-						// pingBack: if true, we will return the server's timestamp, along with our own
-						//			 if false, the timestamp is our own, and we will calculate the latency
-						// timestamp: either the server's own gElapsedTime, or the client's gElapsedTime being sent back
+						//// The server has requested a ping
+						// serverTime: The server's timestamp, which we send back along with our own
 
 						if (gConnection.status != STATUS_PLAYING && gConnection.status != STATUS_SPECTATING)
 								return true;
 
-						bool pingBack = false;
-						sf::Uint64 timestamp;
-						p >> pingBack >> timestamp;
+						SEND(PACKET_CLIENT_PING)(p.serverTime);
+						return true;
+				}
 
-						// We have been asked to ping back, so timestamp is the server's timestamp
-						if (pingBack)
-								SEND(PACKET_CLIENT_PING)(timestamp);
-						// Calculate latency
-						else
-								gConnection.latency = gElapsedTime - ms(timestamp);
+				DEF_CLIENT_RECV(PACKET_SERVER_CLOCK)
+				{
+						//// The server has answered our ping response with its clock
+						// clientTime: Our timestamp from the ping response
+						// serverTime: The server's clock when it answered
+
+						if (gConnection.status != STATUS_PLAYING && gConnection.status != STATUS_SPECTATING)
+								return true;
+
+						bool wasSynchronised = gConnection.clock.IsSynchronised();
+						if (gConnection.clock.AddSample(p.clientTime, p.serverTime, GetClockTime()))
+								gJitterBuffer.Restart();
+
+						if (!wasSynchronised)
+								debug << "CLIENT: Synchronised with the server's clock, round trip is " << gConnection.clock.GetRtt().count() << "us" << std::endl;
 
 						return true;
 				}
@@ -210,90 +364,247 @@ namespace Network
 						if (gConnection.status == STATUS_JOINING)
 								return true;
 
-						WorldSnapshot snapshot;
-						p >> snapshot;
+						const WorldSnapshot& snapshot = p.snapshot;
+
+						SEND(PACKET_CLIENT_ACK)(snapshot.serverTime);
 
-						// Only create a new snapshot if there is not one there already, or we did not
-						// receive multiple snapshots in the same frame
-						if (gSnapshots.empty() || gSnapshots.back().clientTime != gElapsedTime.count())
-								gSnapshots.push_back(snapshot);
+						// Until the first clock sync sample arrives, assume the update took no time to get here
+						gConnection.clock.Seed(snapshot.serverTime, GetClockTime());
 
-						gSnapshots.back().clientTime = gElapsedTime.count();
+						// Snapshots are laid out on the server's clock
+						if (!gSnapshots.empty() && gSnapshots.back().serverTime >= snapshot.serverTime)
+								return true;
+
+						gSnapshots.push_back(snapshot);
+						gJitterBuffer.OnSnapshot(snapshot.serverTime, GetServerTime());
 
 						// Delete old (irrelevant) snapshots
 						sf::Uint64 renderTime = GetRenderTime();
 						DeleteOldSnapshots(renderTime);
 
-						// Set our simulation to be the same as the ser
-						gWorld.UpdateWorld(gSnapshots.back().snapshot);
+						// Where we predicted we are, before the server's state replaces it (and with it our player)
+						bool isPredicted = false;
+						Vector predictedPosition = World::INVALID_POS;
+						if (const Player* predicted = gWorld.GetPlayer(gMyID))
+						{
+								isPredicted = true;
+								predictedPosition = predicted->GetPosition();
+						}
+
+						// How long ago the server took it; the server's bullets we hold are moved along to now
+						sf::Uint64 serverTime = GetServerTime();
+						sf::Uint64 age = (serverTime > snapshot.serverTime) ? (serverTime - snapshot.serverTime) / 1000 : 0;
+
+						// Set our simulation to be the same as the server
+						gWorld.UpdateWorld(snapshot.snapshot, p.complete, age);
+
+						// Time the commands this update acknowledges
+						if (const Player* me = gWorld.GetPlayer(gMyID))
+						{
+								sf::Uint64 now = GetClockTime();
+								sf::Int64 snapshotTime = sf::Int64(snapshot.serverTime) - gConnection.clock.GetOffset();
+								bool isSynchronised = gConnection.clock.IsSynchronised();
+								int lastCommandID = me->GetLastCommandID();
+
+								while (lastCommandID != Player::NO_COMMAND && !gTimedInputs.empty() && gTimedInputs.front().id <= sf::Uint32(lastCommandID))
+								{
+										sf::Int64 inputTime = sf::Int64(gTimedInputs.front().inputTime);
+										gTimedInputs.pop_front();
+
+										gInputLatency.Record(us(sf::Int64(now) - inputTime));
+										if (isSynchronised)
+										{
+												gToServerLatency.Record(us(snapshotTime - inputTime));
+												gFromServerLatency.Record(us(sf::Int64(now) - snapshotTime));
+										}
+								}
+						}
+
+						// The server leaves the bullets out while we have them all, and checks that we do, as they were when it took the snapshot
+						// (partial updates that do carry bullets are still filling ours in, so they are not checked)
+						if (p.checksum.present && (p.complete || snapshot.snapshot.GetBullets().empty()))
+						{
+								if (gWorld.GetServerBulletChecksumAt(age) == p.checksum.value)
+										gIsResyncing = false;
+								else if (!gIsResyncing)
+								{
+										++gDesyncs;
+										debug << "CLIENT: Our bullets no longer match the server's, asking for them again (" << gDesyncs << " times so far)" << std::endl;
+
+										gIsResyncing = true;
+										SEND(PACKET_CLIENT_RESYNC)();
+								}
+						}
 
 						// Reconciliation
-						if (gIsReconciling && !gCommands.empty())
+						if (gIsReconciling && !gPredictions.empty())
 						{
 								Player* me = gWorld.GetPlayer(gMyID);
 								if (!me)
 										return false;
 
 								// ID of the last command the server processed
-								sf::Uint32 lastCommandID = me->GetLastCommandID();
+								int lastCommandID = me->GetLastCommandID();
 
-								// Remove older commands
-								const auto pred = [lastCommandID](const auto& cmd)
+								// Forget the commands it has processed, but not where we predicted the last of them would leave us
+								bool isKnown = false;
+								Vector expected;
+								while (lastCommandID != Player::NO_COMMAND && !gPredictions.empty() && gPredictions.front().cmd.id <= sf::Uint32(lastCommandID))
 								{
-										return cmd.id <= lastCommandID;
-								};
+										if (gPredictions.front().cmd.id == sf::Uint32(lastCommandID))
+										{
+												isKnown = true;
+												expected = gPredictions.front().position;
+										}
 
-								gCommands.erase(
-												std::remove_if(gCommands.begin(), gCommands.end(), pred),
-												gCommands.end()
-											   );
+										gPredictions.pop_front();
+								}
 
-								// Reapply commands the server had not yet processed
-								for (const auto& cmd : gCommands)
-										gWorld.RunCommand(cmd, gMyID, true);
+								// Nothing left that the server has not seen, so its state is ours
+								if (gPredictions.empty())
+										return true;
+
+								// If the server agrees with where we predicted we would be, so does everything we predicted since
+								sf::Vector2f error = ToFloat(me->GetPosition()) - ToFloat(expected);
+								if (isKnown && isPredicted && std::abs(error.x) <= MISPREDICTION_TOLERANCE && std::abs(error.y) <= MISPREDICTION_TOLERANCE)
+								{
+										me->SetPosition(predictedPosition);
+										return true;
+								}
+
+								// Otherwise replay what the server has not processed yet, from the first command after it diverged
+								for (auto& prediction : gPredictions)
+								{
+										gWorld.RunCommand(prediction.cmd, gMyID, true);
+										prediction.position = gWorld.GetPlayer(gMyID)->GetPosition();
+								}
 						}
 
 						return true;
 				}
 
+				DEF_CLIENT_RECV(PACKET_SERVER_BACKLOG)
+				{
+						//// Recent history of the game, sent when we start spectating
+						// snapshots: Oldest first, only the newest one holds bullets
+
+						if (gConnection.status != STATUS_SPECTATING || p.snapshots.empty())
+								return true;
+
+						const WorldSnapshot& newest = p.snapshots.back();
+
+						gConnection.clock.Seed(newest.serverTime, GetClockTime());
+
+						// Snapshots are laid out on the server's clock, so the history slots in as it is
+						gSnapshots.assign(p.snapshots.begin(), p.snapshots.end());
+						gJitterBuffer.OnSnapshot(newest.serverTime, GetServerTime());
+
+						sf::Uint64 serverTime = GetServerTime();
+						gWorld.UpdateWorld(newest.snapshot, true, (serverTime > newest.serverTime) ? (serverTime - newest.serverTime) / 1000 : 0);
+
+						// Bullets that were fired before we joined appear once we have interpolated that far
+						for (const auto& bullet : newest.snapshot.GetBullets())
+								gIncomingBullets.push_back({ newest.serverTime, bullet });
+
+						return true;
+				}
+
 				DEF_CLIENT_RECV(PACKET_SERVER_SHOOT)
 				{
-						//// Another client has fired a bullet
+						//// Another client has fired a bullet, or the server has spawned one we fired
 						// newBullet: The bullet object
 						// serverTime: The timestamp the bullet was spawned on the server
+						// spawnToken: Only there if we fired it; the token we sent with it
 
 						if (gConnection.status != STATUS_PLAYING && gConnection.status != STATUS_SPECTATING)
 								return true;
 
-						Bullet newBullet;
-						sf::Uint64 serverTime;
-						p >> newBullet >> serverTime;
+						// State updates may leave bullets out (see CAPABILITY_CHECKSUMS), so this is how we learn the server has it,
+						// moved along to where it is now
+						Bullet serverBullet = p.bullet;
+						sf::Uint64 serverTime = GetServerTime();
+						if (serverTime > p.serverTime)
+								serverBullet.Update((serverTime - p.serverTime) / 1000);
+
+						gWorld.AddServerBullet(serverBullet);
+
+						// We are showing this bullet already, under an id of our own
+						if (p.spawnToken.present)
+						{
+								auto predicted = gPredictedShots.find(p.spawnToken.value);
+								if (predicted != gPredictedShots.end())
+										gWorld.ConfirmShot(predicted->second, p.bullet);
+
+								// Shots are answered in order, so any tokens before this one are not going to be
+								gPredictedShots.erase(gPredictedShots.begin(), gPredictedShots.upper_bound(p.spawnToken.value));
+								return true;
+						}
 
 						// Store the bullet along with its timestamp
 						// so that we can spawn it when we've interpolated that far
 						FutureBullet fBullet;
-						fBullet.serverTime = serverTime;
-						fBullet.bullet = newBullet;
+						fBullet.serverTime = p.serverTime;
+						fBullet.bullet = p.bullet;
 
 						gIncomingBullets.push_back(fBullet);
 
 						return true;
 				}
 
-				using ClientReceiveCallback = std::function<bool(sf::Packet&)>;
-				const ClientReceiveCallback gReceivePacket[] = {
-						nullptr,						// PACKET_CLIENT_JOIN
-						RECV(PACKET_SERVER_WELCOME),
-						RECV(PACKET_SERVER_SPECTATOR),
-						RECV(PACKET_SERVER_FULL),
-						nullptr,						// PACKET_CLIENT_CMD
-						RECV(PACKET_SERVER_PING),
-						nullptr,						// PACKET_CLIENT_PING
-						RECV(PACKET_SERVER_UPDATE),
-						nullptr,						// PACKET_CLIENT_SHOOT
-						RECV(PACKET_SERVER_SHOOT),
+				DEF_CLIENT_RECV(PACKET_SERVER_RATE)
+				{
+						//// The server has changed how often it sends us state updates
+						// updateInterval: Milliseconds between updates
+
+						if (gConnection.status != STATUS_PLAYING && gConnection.status != STATUS_SPECTATING)
+								return true;
+
+						gJitterBuffer.SetUpdateInterval(ms(p.updateInterval));
+
+						debug << "CLIENT: Server sends updates every " << p.updateInterval << "ms, interpolation delay is " <<
+								std::chrono::duration_cast<ms>(gJitterBuffer.GetDelay()).count() << "ms" << std::endl;
+						return true;
+				}
+
+				DEF_CLIENT_RECV(PACKET_SERVER_COMPRESSED)
+				{
+						//// The server has compressed a packet, since we told it we could handle that
+						// size: Size of the packet before it was compressed
+						// data: The compressed packet
+
+						if (!gConnection.Accepts(CAPABILITY_COMPRESSION_V2))
+								return true;
+
+						sf::Packet inner;
+						if (!DecompressPacket(p, inner))
+						{
+								debug << "CLIENT: Received a packet that would not decompress" << std::endl;
+								return false;
+						}
+
+						return DispatchPacket(static_cast<const sf::Uint8*>(inner.getData()), inner.getDataSize());
+				}
+
+				// Decodes a packet's payload and hands it to its receive function
+				template<PacketType TYPE>
+				struct ReceiveEntry
+				{
+						static bool Call(const sf::Uint8* data, std::size_t size)
+						{
+								Message<TYPE> msg;
+								if (!Decode(data, size, msg))
+								{
+										debug << "CLIENT: Received a malformed packet (type " << TYPE << ')' << std::endl;
+										return false;
+								}
+
+								return RECV(TYPE)(msg);
+						}
 				};
 
+				using ClientReceiveCallback = bool(*)(const sf::Uint8*, std::size_t);
+				constexpr auto gReceivePacket = MakeDispatchTable<ClientReceiveCallback, ReceiveEntry, TO_CLIENT>();
+
 				// Client logic ///////
 
 				void PrintOptions()
@@ -305,6 +616,7 @@ namespace Network
 								setw(FILL_W) << left << "Predicting: " << gIsPredicting << '\n' <<
 								setw(FILL_W) << left << "Reconciliating: " << gIsReconciling << '\n' <<
 								setw(FILL_W) << left << "Interpolating: " << gIsInterpolating << '\n' <<
+								setw(FILL_W) << left << "Extrapolating: " << gIsExtrapolating << '\n' <<
 								setw(FILL_W) << left << "Showing server bullets: " << gShowServerBullets << std::endl;
 				}
 
@@ -312,7 +624,8 @@ namespace Network
 				{
 						debug << "CLIENT: Initialising SFML window..." << std::endl;
 						gWindow = std::make_unique<sf::RenderWindow>(sf::VideoMode(VP_WIDTH, VP_HEIGHT), title);
-						gWindow->setFramerateLimit(30);
+						// Frames are drawn at the display's rate; the simulation keeps its own (see FramePacer)
+						gWindow->setVerticalSyncEnabled(true);
 
 						// NOTE: This never works ...
 						gWindow->requestFocus();
@@ -320,10 +633,21 @@ namespace Network
 						PrintOptions();
 				}
 
-				// The time in the past we are showing
+				sf::Uint64 GetClockTime()
+				{
+						return to_us(gStartTime, the_clock::now()).count();
+				}
+
+				// Our estimate of the server's clock right now
+				sf::Uint64 GetServerTime()
+				{
+						return gConnection.clock.ToRemote(GetClockTime());
+				}
+
+				// The time in the past we are showing, on the server's clock (moved on once a frame)
 				sf::Uint64 GetRenderTime()
 				{
-						return (gElapsedTime.count() > INTERPOLATION_TIME_MS) ? gElapsedTime.count() - INTERPOLATION_TIME_MS : 0;
+						return gJitterBuffer.GetRenderTime();
 				}
 
 				void DeleteOldSnapshots(sf::Uint64 renderTime)
@@ -331,7 +655,7 @@ namespace Network
 						for (auto it = gSnapshots.rbegin(); it != gSnapshots.rend(); ++it)
 						{
 								// If this snapshot came before our render time
-								if (it->clientTime <= renderTime)
+								if (it->serverTime <= renderTime)
 								{
 										// Start deleting from this point
 										gSnapshots.erase(gSnapshots.begin(), (++it).base());
@@ -352,6 +676,16 @@ namespace Network
 						return true;
 				}
 
+				void ReportLatencies()
+				{
+						if (gInputLatency.GetCount() == 0)
+								return;
+
+						debug << "CLIENT: Input latency:  " << gInputLatency.Describe() << '\n' <<
+								 "CLIENT:   to server:    " << gToServerLatency.Describe() << '\n' <<
+								 "CLIENT:   from server:  " << gFromServerLatency.Describe() << std::endl;
+				}
+
 				void Disconnect()
 				{
 						// TODO: Notify server that we disconnected intentionally
@@ -359,23 +693,28 @@ namespace Network
 						gConnection.Disconnect();
 				}
 
-				bool ReceiveFromServer()
+				bool DispatchPacket(const sf::Uint8* data, std::size_t size)
 				{
-						while (true)
-						{
-								sf::Packet p;
-								if (!gConnection.Receive(p))
-										break;
+						if (size == 0)
+								return true;
 
-								sf::Uint8 type;
-								p >> type;
+						sf::Uint8 type = data[0];
 
-								// Call the appropriate receive function based on the packet-type
-								if (type < PACKET_END && gReceivePacket[type] != nullptr)
-								{
-										if (!gReceivePacket[type](p))
-												return false;
-								}
+						// Call the appropriate receive function based on the packet-type
+						if (type < PACKET_END && gReceivePacket[type] != nullptr)
+								return gReceivePacket[type](data + 1, size - 1);
+
+						return true;
+				}
+
+				bool ReceiveFromServer()
+				{
+						const sf::Uint8* data;
+						std::size_t size;
+						while (gConnection.Receive(data, size))
+						{
+								if (!DispatchPacket(data, size))
+										return false;
 						}
 
 						if (!gConnection.active)
@@ -437,6 +776,13 @@ namespace Network
 																				changedOptions = true;
 																		}
 																		break;
+																case Key::F5:
+																		{
+																				gIsExtrapolating = !gIsExtrapolating;
+
+																				changedOptions = true;
+																		}
+																		break;
 																case Key::Space:
 																		SEND(PACKET_CLIENT_SHOOT)();
 																		break;
@@ -478,9 +824,10 @@ namespace Network
 										// Client-side prediction
 										if (gIsPredicting)
 										{
-												gCommands.push_back(cmd);
-
 												gWorld.RunCommand(cmd, gMyID, false);
+
+												const Player* me = gWorld.GetPlayer(gMyID);
+												gPredictions.push_back({ cmd, me ? me->GetPosition() : World::INVALID_POS });
 										}
 
 										// Send to server
@@ -497,7 +844,7 @@ namespace Network
 
 						for (auto& snapshot : gSnapshots)
 						{
-								if (snapshot.clientTime > renderTime)
+								if (snapshot.serverTime > renderTime)
 								{
 										to = &snapshot;
 										break;
@@ -512,36 +859,98 @@ namespace Network
 				// Linearly interpolate the other player's position based on our delay
 				void Interpolate(const WorldSnapshot& from, const WorldSnapshot& to, sf::Uint64 renderTime)
 				{
-						float alpha = (float) (renderTime - from.clientTime) / (float) (to.clientTime - from.clientTime);
+						float alpha = (float) (renderTime - from.serverTime) / (float) (to.serverTime - from.serverTime);
 
 						for (const auto& playerFrom : from.snapshot.GetPlayers())
 						{
-								for (const auto& playerTo : to.snapshot.GetPlayers())
+								// Only interpolate if this is the same player in both snapshots, and it is not us
+								const Player* playerTo = to.snapshot.GetPlayer(playerFrom.GetID());
+								if (!playerTo || playerFrom.GetID() == gMyID)
+										continue;
+
+								auto playerReal = gWorld.GetPlayer(playerFrom.GetID());
+								if (playerReal)
 								{
-										// Only interpolate if this is the same player in both snapshots, and it is not us
-										if (playerFrom.GetID() == playerTo.GetID() && playerFrom.GetID() != gMyID)
-										{
-												auto playerReal = gWorld.GetPlayer(playerFrom.GetID());
-												if (playerReal)
-												{
-														sf::Vector2f newPos = (playerTo.GetPosition() - playerFrom.GetPosition()) * alpha + playerFrom.GetPosition();
-														playerReal->SetPosition(newPos);
-												}
-										}
+										// Remote players are only ever drawn, so they are interpolated in floats
+										sf::Vector2f posFrom = ToFloat(playerFrom.GetPosition());
+										sf::Vector2f posTo = ToFloat(playerTo->GetPosition());
+
+										sf::Vector2f newPos = (posTo - posFrom) * alpha + posFrom;
+										playerReal->SetPosition(ToVector(newPos));
+
+										// Remember how they were moving, in case the next update is late
+										float span = (float) (to.serverTime - from.serverTime);
+										auto motion = gRemoteMotion.emplace(playerFrom.GetID(), RemoteMotion{ {}, newPos, {} }).first;
+										motion->second.velocity = (posTo - posFrom) / span;
+										motion->second.isPlaced = true;
+								}
+						}
+				}
+
+				// Keep remote players moving the way they were for a while, when we have run out of snapshots
+				void Extrapolate(const WorldSnapshot& from, sf::Uint64 renderTime)
+				{
+						float elapsed = (float) std::min<sf::Uint64>(renderTime - from.serverTime, us(ms(EXTRAPOLATION_LIMIT_MS)).count());
+
+						for (const auto& player : from.snapshot.GetPlayers())
+						{
+								auto motion = gRemoteMotion.find(player.GetID());
+								if (player.GetID() == gMyID || motion == gRemoteMotion.end())
+										continue;
+
+								auto playerReal = gWorld.GetPlayer(player.GetID());
+								if (playerReal)
+								{
+										playerReal->SetPosition(ToVector(ToFloat(player.GetPosition()) + motion->second.velocity * elapsed));
+										motion->second.isPlaced = true;
+								}
+						}
+				}
+
+				// Where we extrapolated remote players to is not quite where they were, so when updates come in again
+				// the difference is made up over a short time instead of snapping them into place
+				void ConvergeRemotePlayers(ms dt, bool resumed)
+				{
+						float decay = std::exp(-(float) dt.count() / CONVERGENCE_TIME_MS);
+
+						for (auto it = gRemoteMotion.begin(); it != gRemoteMotion.end(); )
+						{
+								auto playerReal = gWorld.GetPlayer(it->first);
+								if (!playerReal)
+								{
+										it = gRemoteMotion.erase(it);
+										continue;
 								}
+
+								RemoteMotion& motion = it->second;
+								if (resumed)
+										motion.error = motion.shown - ToFloat(playerReal->GetPosition());
+								else
+										motion.error *= decay;
+
+								// Only on top of where Interpolate or Extrapolate put them this frame; when neither did (extrapolation
+								// is off and the next update is late), the error is in their position already, and adding it every
+								// frame would carry them off
+								if (motion.isPlaced)
+								{
+										playerReal->SetPosition(ToVector(ToFloat(playerReal->GetPosition()) + motion.error));
+										motion.shown = ToFloat(playerReal->GetPosition());
+										motion.isPlaced = false;
+								}
+
+								++it;
 						}
 				}
 
 				void ClientLoop()
 				{
 						gIsRunning = true;
+						gPacer.Start(the_clock::now());
 
 						ms dt{ 0 };
 						// Main loop
 						while (gIsRunning)
 						{
-								auto startFrame = the_clock::now();
-
 								// Networking
 								if (!ReceiveFromServer())
 										break;
@@ -550,24 +959,31 @@ namespace Network
 								{
 										// When joining, we are just waiting to receive PACKET_SERVER_{WELCOME,SPECTATOR,FULL}
 										case STATUS_JOINING:
+												gPacer.Start(the_clock::now());
 												continue;
 
-												// When playing, we want to handle user input
+										// Debug and 'meta' input, every frame, so the window stays responsive
 										case STATUS_PLAYING:
-												// Movement input
-												BuildCommand(dt);
-
-												// When spectating, we want to be able toggle options on and off
 										case STATUS_SPECTATING:
-												// Debug and 'meta' input
 												if (!HandleEvents())
 														gIsRunning = false;
 								}
 
-								// Bullet prediction
-								gWorld.Update(dt.count());
+								// Movement input and prediction, at the simulation's rate rather than the frame rate
+								int steps = gPacer.Advance(the_clock::now());
+								for (int i = 0; i < steps; ++i)
+								{
+										gPreviousWorld = gWorld;
+
+										if (gConnection.status == STATUS_PLAYING)
+												BuildCommand(gPacer.GetStep());
 
-								sf::Uint64 renderTime = GetRenderTime();
+										// Bullet prediction
+										gWorld.Update(gPacer.GetStep().count());
+								}
+
+								// The render clock runs on the server's clock, so it waits until we have an estimate of that
+								sf::Uint64 renderTime = gConnection.clock.IsSeeded() ? gJitterBuffer.Advance(gConnection.clock.ToRemote(gElapsedTime.count())) : GetRenderTime();
 
 								// Get the two snapshots between which the position @ renderTime exists
 								auto snapshots = GetRelevantSnapshots(renderTime);
@@ -587,29 +1003,52 @@ namespace Network
 														++it;
 										}
 
-										// Interpolation
-										if (gIsInterpolating && to)
-												Interpolate(*from, *to, renderTime);
+										// Interpolation, or extrapolation if the next update has not arrived yet
+										if (gIsInterpolating)
+										{
+												bool isExtrapolating = !to && gIsExtrapolating;
+
+												if (to)
+														Interpolate(*from, *to, renderTime);
+												else if (isExtrapolating)
+														Extrapolate(*from, renderTime);
+
+												ConvergeRemotePlayers(dt, gWasExtrapolating && !isExtrapolating);
+												gWasExtrapolating = isExtrapolating;
+										}
 								}
 
-								// Render
+								// Bullets we never got as far as showing (no snapshots came in to interpolate between) would be gone by now
+								gIncomingBullets.erase(std::remove_if(gIncomingBullets.begin(), gIncomingBullets.end(), [&](const FutureBullet& fBullet) {
+										return renderTime > fBullet.serverTime + BULLET_LIFETIME_US;
+								}), gIncomingBullets.end());
+
+								// Render, between the last simulation step and the next
 								gWindow->clear();
-								World::RenderWorld(gWorld, *gWindow, gShowServerBullets);
+								RenderWorld(gWorld.Blend(gPreviousWorld, gPacer.GetAlpha(), gMyID), *gWindow, gShowServerBullets);
 								gWindow->display();
 
-								auto endFrame = the_clock::now();
+								// Timing (measured from the start, so it does not drift)
+								us elapsedTime = to_us(gStartTime, the_clock::now());
+								dt = std::chrono::duration_cast<ms>(elapsedTime) - std::chrono::duration_cast<ms>(gElapsedTime);
+								gElapsedTime = elapsedTime;
 
-								// Timing
-								dt = std::chrono::duration_cast<ms>(endFrame - startFrame);
-								gElapsedTime += dt;
+								if (gElapsedTime >= gNextLatencyReport)
+								{
+										ReportLatencies();
+										gNextLatencyReport = gElapsedTime + ms(LATENCY_REPORT_INTERVAL_MS);
+								}
 						}
 
 						debug << "CLIENT: Closing..." << std::endl;
+						ReportLatencies();
 						gIsRunning = false;
 				}
 
 				bool StartClient(const sf::IpAddress& address, Port port)
 				{
+						gStartTime = the_clock::now();
+
 						if (!ConnectToServer(address, port))
 						{
 								debug << "CLIENT: Failed to connect to server" << std::endl;
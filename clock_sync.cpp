@@ -0,0 +1,79 @@
+#include "clock_sync.h"
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+namespace Network
+{
+	namespace
+	{
+		// Samples whose round trip is within this much of the quickest one (or half of it, if that is more) are trusted
+		constexpr int RTT_TOLERANCE_US = 2000;
+
+		// Differences larger than this are stepped to at once, smaller ones are slewed towards
+		constexpr int STEP_LIMIT_US = 100000;
+		constexpr int SLEW_DIVISOR = 4;
+	}
+
+	void ClockSync::Seed(sf::Uint64 remoteTime, sf::Uint64 localTime)
+	{
+		if (mIsSeeded)
+			return;
+
+		mOffset = sf::Int64(remoteTime) - sf::Int64(localTime);
+		mIsSeeded = true;
+	}
+
+	bool ClockSync::AddSample(sf::Uint64 sentAt, sf::Uint64 remoteTime, sf::Uint64 receivedAt)
+	{
+		if (receivedAt < sentAt)
+			return false;
+
+		// The other end answered somewhere during the round trip; assume halfway
+		us rtt(receivedAt - sentAt);
+		sf::Int64 offset = sf::Int64(remoteTime) - sf::Int64(sentAt + rtt.count() / 2);
+
+		mSamples[mSampleCount % SAMPLE_COUNT] = { offset, rtt };
+		++mSampleCount;
+
+		std::size_t count = std::min(mSampleCount, SAMPLE_COUNT);
+
+		us minRtt = mSamples[0].rtt;
+		for (std::size_t i = 1; i < count; ++i)
+			minRtt = std::min(minRtt, mSamples[i].rtt);
+
+		us limit = minRtt + std::max(minRtt / 2, us(RTT_TOLERANCE_US));
+
+		// Median of the trusted samples
+		std::vector<Sample> trusted;
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			if (mSamples[i].rtt <= limit)
+				trusted.push_back(mSamples[i]);
+		}
+
+		auto middle = trusted.begin() + trusted.size() / 2;
+		std::nth_element(trusted.begin(), middle, trusted.end(), [](const Sample& a, const Sample& b) { return a.offset < b.offset; });
+		sf::Int64 target = middle->offset;
+
+		std::nth_element(trusted.begin(), middle, trusted.end(), [](const Sample& a, const Sample& b) { return a.rtt < b.rtt; });
+		mRtt = middle->rtt;
+
+		// Slewing keeps the clock from jumping back and forth with every sample
+		sf::Int64 difference = target - mOffset;
+		bool isStep = (mSampleCount == 1 || std::llabs(difference) > STEP_LIMIT_US);
+		if (isStep)
+			mOffset = target;
+		else
+			mOffset += difference / SLEW_DIVISOR;
+
+		mIsSeeded = true;
+		return isStep;
+	}
+
+	sf::Uint64 ClockSync::ToRemote(sf::Uint64 localTime) const
+	{
+		sf::Int64 remoteTime = sf::Int64(localTime) + mOffset;
+		return (remoteTime > 0) ? sf::Uint64(remoteTime) : 0;
+	}
+}
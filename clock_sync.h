@@ -0,0 +1,49 @@
+#pragma once
+#include <SFML/System.hpp>
+#include <array>
+#include "common.h"
+
+// clock_sync.h: Estimates the offset between our clock and another machine's, NTP style
+//				 Only recent samples close to the quickest round trip are trusted. Times are in microseconds
+
+namespace Network
+{
+	class ClockSync
+	{
+	public:
+		// Rough estimate until the first sample arrives, assuming 'remoteTime' took no time to get here
+		void Seed(sf::Uint64 remoteTime, sf::Uint64 localTime);
+
+		// sentAt, receivedAt: Our clock when the request was sent and the answer received
+		// remoteTime: The other end's clock when it answered
+		// Returns true if the estimate jumped to the new offset rather than easing towards it
+		bool AddSample(sf::Uint64 sentAt, sf::Uint64 remoteTime, sf::Uint64 receivedAt);
+
+		bool IsSeeded() const { return mIsSeeded; }
+		bool IsSynchronised() const { return mSampleCount > 0; }
+
+		sf::Uint64 ToRemote(sf::Uint64 localTime) const;
+
+		// The other end's clock minus ours
+		sf::Int64 GetOffset() const { return mOffset; }
+		// Round trip time without queueing delays
+		us GetRtt() const { return mRtt; }
+		us GetOneWayDelay() const { return mRtt / 2; }
+
+	private:
+		static constexpr std::size_t SAMPLE_COUNT = 8;
+
+		struct Sample
+		{
+			sf::Int64 offset;
+			us rtt;
+		};
+
+		std::array<Sample, SAMPLE_COUNT> mSamples;
+		std::size_t mSampleCount = 0;
+
+		sf::Int64 mOffset = 0;
+		us mRtt{ 0 };
+		bool mIsSeeded = false;
+	};
+}
@@ -1,11 +1,7 @@
 #pragma once
 #include <cstdint>
+#include <tuple>
 #include <SFML/System.hpp>
-	
-namespace sf
-{
-	class Packet;
-}
 
 struct Command
 {
@@ -16,7 +12,7 @@ struct Command
 		IDLE, LEFT, RIGHT
 	} direction;
 	sf::Uint64 dt;
-};
 
-sf::Packet& operator<<(sf::Packet& p, const Command& cmd);
-sf::Packet& operator >> (sf::Packet& p, Command& cmd);
+	// Wire layout (protocol.h)
+	static constexpr auto Fields() { return std::make_tuple(&Command::id, &Command::direction, &Command::dt); }
+};
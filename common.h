@@ -1,6 +1,5 @@
 #pragma once
 #include <chrono>
-#include <SFML/Window.hpp>
 
 // common.h: Commonly used variables and shorthands
 
@@ -22,15 +21,19 @@ constexpr float BULLET_H = 24.f;
 constexpr float H_BULLET_W = BULLET_W * 0.5f;
 constexpr float H_BULLET_H = BULLET_H * 0.5f;
 
-// SFML Shortcuts
-using Key = sf::Keyboard::Key;
-
 // Chrono
-using the_clock = std::chrono::high_resolution_clock;
+// Timestamps are measured on a steady clock, so they never jump when the system time is adjusted
+using the_clock = std::chrono::steady_clock;
 using time_point = std::chrono::time_point<the_clock>;
 using ms = std::chrono::milliseconds;
+using us = std::chrono::microseconds;
 
 inline ms to_ms(const time_point& start, const time_point& end)
 {
   return std::chrono::duration_cast<ms>(end - start);
 }
+
+inline us to_us(const time_point& start, const time_point& end)
+{
+  return std::chrono::duration_cast<us>(end - start);
+}
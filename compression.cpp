@@ -0,0 +1,259 @@
+#include "compression.h"
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+#ifdef NETWORKING_DETERMINISTIC
+#include "compression_dictionary_fixed.h"
+#else
+#include "compression_dictionary.h"
+#endif
+
+namespace Compression
+{
+	namespace
+	{
+		constexpr std::size_t MIN_MATCH = 4;
+		constexpr std::size_t MAX_OFFSET = 0xFFFF;
+
+		constexpr int HASH_BITS = 12;
+
+		// The last bytes are always literals, so a match never reads past the end of the input
+		constexpr std::size_t END_LITERALS = 5;
+
+		sf::Uint32 Read32(const sf::Uint8* p)
+		{
+			sf::Uint32 v;
+			std::memcpy(&v, p, sizeof(v));
+			return v;
+		}
+
+		std::size_t Hash(const sf::Uint8* p)
+		{
+			return (Read32(p) * 2654435761u) >> (32 - HASH_BITS);
+		}
+
+		void WriteLength(std::vector<sf::Uint8>& out, std::size_t length)
+		{
+			for (; length >= 255; length -= 255)
+				out.push_back(255);
+			out.push_back(sf::Uint8(length));
+		}
+
+		bool ReadLength(const sf::Uint8*& in, const sf::Uint8* end, std::size_t& length)
+		{
+			sf::Uint8 byte;
+			do
+			{
+				if (in == end)
+					return false;
+
+				byte = *in++;
+				length += byte;
+			} while (byte == 255);
+
+			return true;
+		}
+
+		void WriteSequence(std::vector<sf::Uint8>& out, const sf::Uint8* literals, std::size_t literalCount, std::size_t offset, std::size_t matchLength)
+		{
+			std::size_t matchCode = matchLength ? matchLength - MIN_MATCH : 0;
+
+			out.push_back(sf::Uint8((std::min<std::size_t>(literalCount, 15) << 4) | std::min<std::size_t>(matchCode, 15)));
+			if (literalCount >= 15)
+				WriteLength(out, literalCount - 15);
+
+			out.insert(out.end(), literals, literals + literalCount);
+
+			if (!matchLength)
+				return;
+
+			out.push_back(sf::Uint8(offset >> 8));
+			out.push_back(sf::Uint8(offset));
+			if (matchCode >= 15)
+				WriteLength(out, matchCode - 15);
+		}
+	}
+
+	bool Compress(const sf::Uint8* data, std::size_t size, std::vector<sf::Uint8>& out)
+	{
+		// Matches can reach back into the dictionary, so it goes right before the data
+		thread_local std::vector<sf::Uint8> window;
+		window.assign(DICTIONARY, DICTIONARY + sizeof(DICTIONARY));
+		window.insert(window.end(), data, data + size);
+
+		thread_local std::vector<std::size_t> table;
+		table.assign(std::size_t(1) << HASH_BITS, 0);
+
+		const sf::Uint8* base = window.data();
+		const std::size_t start = sizeof(DICTIONARY);
+		const std::size_t end = window.size();
+		const std::size_t matchLimit = (end > END_LITERALS) ? end - END_LITERALS : 0;
+
+		for (std::size_t i = 0; i + MIN_MATCH <= start; ++i)
+			table[Hash(base + i)] = i + 1;
+
+		std::size_t outStart = out.size();
+		std::size_t anchor = start;
+		std::size_t i = start;
+
+		while (i + MIN_MATCH <= matchLimit)
+		{
+			std::size_t h = Hash(base + i);
+			std::size_t candidate = table[h];
+			table[h] = i + 1;
+
+			if (candidate == 0 || i - (candidate - 1) > MAX_OFFSET || Read32(base + candidate - 1) != Read32(base + i))
+			{
+				++i;
+				continue;
+			}
+
+			std::size_t match = candidate - 1;
+			std::size_t length = MIN_MATCH;
+			while (i + length < matchLimit && base[match + length] == base[i + length])
+				++length;
+
+			WriteSequence(out, base + anchor, i - anchor, i - match, length);
+
+			i += length;
+			anchor = i;
+
+			// Bail out as soon as it is clear this will not get any smaller
+			if (out.size() - outStart >= size)
+				break;
+		}
+
+		WriteSequence(out, base + anchor, end - anchor, 0, 0);
+
+		if (out.size() - outStart >= size)
+		{
+			out.resize(outStart);
+			return false;
+		}
+
+		return true;
+	}
+
+	bool Decompress(const sf::Uint8* data, std::size_t size, std::size_t originalSize, std::vector<sf::Uint8>& out)
+	{
+		thread_local std::vector<sf::Uint8> window;
+		window.assign(DICTIONARY, DICTIONARY + sizeof(DICTIONARY));
+
+		const std::size_t limit = sizeof(DICTIONARY) + originalSize;
+		window.reserve(limit);
+
+		const sf::Uint8* in = data;
+		const sf::Uint8* end = data + size;
+
+		while (in < end)
+		{
+			sf::Uint8 token = *in++;
+
+			std::size_t literalCount = token >> 4;
+			if (literalCount == 15 && !ReadLength(in, end, literalCount))
+				return false;
+
+			if (std::size_t(end - in) < literalCount || limit - window.size() < literalCount)
+				return false;
+
+			window.insert(window.end(), in, in + literalCount);
+			in += literalCount;
+
+			// Last sequence
+			if (in == end)
+				break;
+
+			if (end - in < 2)
+				return false;
+
+			std::size_t offset = (std::size_t(in[0]) << 8) | in[1];
+			in += 2;
+
+			std::size_t length = token & 0x0F;
+			if (length == 15 && !ReadLength(in, end, length))
+				return false;
+			length += MIN_MATCH;
+
+			if (offset == 0 || offset > window.size() || limit - window.size() < length)
+				return false;
+
+			// Byte by byte, since a match may overlap what it is copying
+			std::size_t from = window.size() - offset;
+			for (std::size_t n = 0; n < length; ++n)
+				window.push_back(window[from + n]);
+		}
+
+		if (window.size() != limit)
+			return false;
+
+		out.insert(out.end(), window.begin() + sizeof(DICTIONARY), window.end());
+		return true;
+	}
+
+	std::vector<sf::Uint8> TrainDictionary(const std::vector<std::vector<sf::Uint8>>& samples, std::size_t dictionarySize)
+	{
+		constexpr std::size_t GRAM = 8;
+		constexpr std::size_t SEGMENT = 16;
+
+		const auto gramAt = [](const sf::Uint8* p)
+		{
+			sf::Uint64 gram;
+			std::memcpy(&gram, p, GRAM);
+			return gram;
+		};
+
+		// How many samples each 8-byte sequence appears in
+		std::unordered_map<sf::Uint64, std::size_t> frequency;
+		for (const auto& sample : samples)
+		{
+			std::unordered_set<sf::Uint64> seen;
+			for (std::size_t i = 0; i + GRAM <= sample.size(); ++i)
+				seen.insert(gramAt(sample.data() + i));
+
+			for (auto gram : seen)
+				++frequency[gram];
+		}
+
+		// Greedily take the segment that covers the most common sequences not covered yet
+		std::unordered_set<sf::Uint64> covered;
+		std::vector<sf::Uint8> dictionary;
+
+		while (dictionary.size() + SEGMENT <= dictionarySize)
+		{
+			std::size_t bestScore = 0;
+			const sf::Uint8* best = nullptr;
+
+			for (const auto& sample : samples)
+			{
+				for (std::size_t i = 0; i + SEGMENT <= sample.size(); i += 4)
+				{
+					std::size_t score = 0;
+					for (std::size_t j = 0; j + GRAM <= SEGMENT; ++j)
+					{
+						sf::Uint64 gram = gramAt(sample.data() + i + j);
+						if (!covered.count(gram))
+							score += frequency[gram];
+					}
+
+					if (score > bestScore)
+					{
+						bestScore = score;
+						best = sample.data() + i;
+					}
+				}
+			}
+
+			// Nothing left that is worth having
+			if (!best || bestScore <= SEGMENT - GRAM + 1)
+				break;
+
+			for (std::size_t j = 0; j + GRAM <= SEGMENT; ++j)
+				covered.insert(gramAt(best + j));
+
+			dictionary.insert(dictionary.end(), best, best + SEGMENT);
+		}
+
+		return dictionary;
+	}
+}
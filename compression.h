@@ -0,0 +1,25 @@
+#pragma once
+#include <SFML/System.hpp>
+#include <vector>
+
+// compression.h: A small LZ77 compressor for packets, in the style of LZ4
+//				  Both ends share a preset dictionary, which matches can refer back into
+//
+//				  Format: a series of sequences, each [token][literals][offset][match], where the token's
+//				  high nibble is the number of literals and its low nibble the match length minus MIN_MATCH
+//				  (15 in either means more length bytes follow, LZ4 style), and the offset is a Uint16 counting
+//				  back from the current position. The last sequence only holds literals.
+
+namespace Compression
+{
+	// Appends 'data' compressed to 'out'
+	// Returns false, leaving 'out' as it was, if compressing would not make it smaller
+	bool Compress(const sf::Uint8* data, std::size_t size, std::vector<sf::Uint8>& out);
+
+	// Appends the 'originalSize' bytes 'data' decompresses to to 'out'
+	// Returns false if 'data' is malformed, or does not decompress to exactly that many bytes
+	bool Decompress(const sf::Uint8* data, std::size_t size, std::size_t originalSize, std::vector<sf::Uint8>& out);
+
+	// Builds a dictionary of the byte sequences most common across 'samples'
+	std::vector<sf::Uint8> TrainDictionary(const std::vector<std::vector<sf::Uint8>>& samples, std::size_t dictionarySize);
+}
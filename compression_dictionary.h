@@ -0,0 +1,78 @@
+#pragma once
+#include <SFML/System.hpp>
+
+// compression_dictionary.h: Preset dictionary for compression.h
+//							 Generated by networking-dictionary (dictionary_main.cpp) from recorded matches; run it again
+//							 on recordings made with the current build to regenerate it. Both ends must use the same
+//							 dictionary, so changing it (or the layout of state updates) needs a new compression
+//							 capability bit (see CAPABILITY_COMPRESSION_V2 in protocol.h)
+
+namespace Compression
+{
+	constexpr sf::Uint8 DICTIONARY[] = {
+		0x0F, 0xA0, 0xFF, 0xA0, 0xFF, 0x00, 0x00, 0x00, 0x00, 0xBF, 0x80, 0x00, 0x00, 0x44, 0x3E, 0x00,
+		0x0C, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x3F, 0x80, 0x00, 0x00, 0x44, 0x3E, 0x00,
+		0x00, 0x41, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x01, 0xA0, 0xFF, 0xA0,
+		0x08, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01, 0xFF, 0xA0, 0xA0,
+		0x80, 0xA0, 0xFF, 0xA0, 0xFF, 0x44, 0x3E, 0x00, 0x00, 0x44, 0x13, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0xD5, 0xFF, 0xA0, 0xA0, 0xFF, 0x42, 0x20, 0x00, 0x00, 0x41, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0xFF, 0x00, 0x00, 0x00, 0x00, 0x3F, 0x80, 0x00, 0x00, 0x42, 0x20, 0x00, 0x00, 0x43, 0x1A, 0x66,
+		0xFF, 0x00, 0x00, 0x00, 0x00, 0xBF, 0x80, 0x00, 0x00, 0x42, 0x20, 0x00, 0x00, 0x42, 0x50, 0x00,
+		0x47, 0xFF, 0xA0, 0xA0, 0xFF, 0x44, 0x3E, 0x00, 0x00, 0x41, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0xA0, 0xA0, 0xFF, 0xA0, 0xFF, 0x42, 0x20, 0x00, 0x00, 0x44, 0x13, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0x03, 0xA0, 0xFF, 0xA0, 0xFF, 0x00, 0x00, 0x00, 0x00, 0xBF, 0x80, 0x00, 0x00, 0x43, 0x6E, 0x66,
+		0x07, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x3F, 0x80, 0x00, 0x00, 0x43, 0x8A, 0x66,
+		0x00, 0xBF, 0x80, 0x00, 0x00, 0x44, 0x3E, 0x00, 0x00, 0x43, 0xED, 0x33, 0x33, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 0x63, 0x00, 0x02, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0xFF, 0x43, 0x83, 0xFF, 0xFD, 0x44, 0x13, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 0x02, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 0x61, 0x00, 0x04, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x06, 0x00, 0x89, 0x00, 0x0C, 0xA0, 0xFF, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x86, 0x00, 0x04, 0xA0, 0xFF, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 0x32, 0x00, 0x03, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x4D, 0x00, 0x07, 0xA0, 0xFF, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x8B, 0x00, 0x09, 0xA0, 0xFF, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x55, 0x00, 0x0F, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x04, 0x00, 0x05, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0xFF, 0x43, 0x9D, 0x99, 0x95, 0x44, 0x13, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x3D, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x07, 0x00, 0x0F, 0x00, 0x05, 0xA0, 0xFF, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 0x75, 0x00, 0x09, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0xFF, 0x42, 0x39, 0x99, 0x9A, 0x44, 0x13, 0x00, 0x00, 0x00, 0x00, 0x00, 0x06, 0x00, 0x09, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x56, 0x00, 0x01, 0xA0, 0xFF, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x2F, 0x00, 0x01, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 0x1C, 0x00, 0x06, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x06, 0x00, 0x06, 0x00, 0x02, 0xA0, 0xFF, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x6E, 0x00, 0x08, 0xA0, 0xFF, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0xFF, 0x43, 0x97, 0x33, 0x2F, 0x44, 0x13, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0x00, 0x24, 0x00,
+		0x00, 0x3F, 0x80, 0x00, 0x00, 0x44, 0x3E, 0x00, 0x00, 0x42, 0x50, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 0x1F, 0x00, 0x0F, 0xA0, 0xFF, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x06, 0x00, 0x50, 0x00, 0x0E, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x49, 0x00, 0x08, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0xFF, 0x43, 0xA3, 0xFF, 0xFB, 0x44, 0x13, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x32, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x01, 0x00, 0x0D, 0xA0, 0xFF, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 0x4A, 0x00, 0x0A, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x06, 0x00, 0x9B, 0x00, 0x03, 0xA0, 0xFF, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x25, 0x00, 0x0C, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 0x3D, 0x00, 0x0E, 0xA0, 0xFF, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 0x22, 0x00, 0x0D, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x06, 0x00, 0x0F, 0x00, 0x07, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x06, 0x00, 0x07, 0x00, 0x0B, 0xA0, 0xFF, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x20, 0x00, 0x06, 0xA0, 0xFF, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x04, 0x00, 0x0B, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0xFF, 0x43, 0xA0, 0xCC, 0xC8, 0x44, 0x13, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x13, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x2A, 0x00, 0x11, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 0x26, 0x00, 0x0A, 0xA0, 0xFF, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x06, 0x00, 0x02, 0x00, 0x10, 0xA0, 0xFF, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0xFF, 0x43, 0x31, 0x99, 0x72, 0x44, 0x13, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x3D, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x07, 0x00, 0x38, 0x00, 0x10, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0xFF, 0x44, 0x27, 0x99, 0x94, 0x44, 0x13, 0x00, 0x00, 0x00, 0x00, 0x00, 0x09, 0x00, 0x71, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x09, 0x00, 0x2D, 0x00, 0x11, 0xA0, 0xFF, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0xBF, 0x80, 0x00, 0x00, 0x42, 0x20, 0x00, 0x00, 0x44, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0x00, 0xBF, 0x80, 0x00, 0x00, 0x44, 0x3E, 0x00, 0x00, 0x44, 0x09, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0xBE, 0xFF, 0xA0, 0xA0, 0xFF, 0x44, 0x15, 0xFF, 0xF6, 0x41, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0x44, 0xFF, 0xA0, 0xA0, 0xFF, 0x43, 0x9A, 0x66, 0x62, 0x41, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0xFF, 0x42, 0x6C, 0xCC, 0xCE, 0x44, 0x13, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x18, 0x00,
+		0xFF, 0x43, 0x8D, 0x99, 0x96, 0x44, 0x13, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0A, 0x00, 0x9A, 0x00,
+		0xFF, 0x00, 0x00, 0x00, 0x00, 0x3F, 0x80, 0x00, 0x00, 0x44, 0x39, 0x33, 0x32, 0x43, 0xC6, 0x66,
+		0xFF, 0x00, 0x00, 0x00, 0x00, 0x3F, 0x80, 0x00, 0x00, 0x43, 0x9A, 0x66, 0x62, 0x43, 0xDA, 0xCC,
+	};
+}
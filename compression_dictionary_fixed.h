@@ -0,0 +1,78 @@
+#pragma once
+#include <SFML/System.hpp>
+
+// compression_dictionary_fixed.h: Preset dictionary for compression.h, in builds with NETWORKING_DETERMINISTIC
+//							 Generated by networking-dictionary (dictionary_main.cpp) from recorded matches; run it again
+//							 on recordings made with the current build to regenerate it. Both ends must use the same
+//							 dictionary, so changing it (or the layout of state updates) needs a new compression
+//							 capability bit (see CAPABILITY_COMPRESSION_V2 in protocol.h)
+
+namespace Compression
+{
+	constexpr sf::Uint8 DICTIONARY[] = {
+		0x0F, 0xA0, 0xFF, 0xA0, 0xFF, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0x00, 0x00, 0x02, 0xF8, 0x00,
+		0x0C, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x28, 0x00,
+		0x00, 0x00, 0x0C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x01, 0xA0, 0xFF, 0xA0,
+		0x08, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x01, 0x07, 0xFF, 0xA0, 0xA0,
+		0x80, 0xA0, 0xFF, 0xA0, 0xFF, 0x02, 0xF8, 0x00, 0x00, 0x02, 0x4C, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0xD5, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x28, 0x00, 0x00, 0x00, 0x0C, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0xFF, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x28, 0x00, 0x00, 0x00, 0x9A, 0x66,
+		0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x02, 0xF8, 0x00, 0x00, 0x01, 0xDA, 0x66,
+		0x47, 0xFF, 0xA0, 0xA0, 0xFF, 0x02, 0xF8, 0x00, 0x00, 0x00, 0x0C, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0xA0, 0xA0, 0xFF, 0xA0, 0xFF, 0x00, 0x28, 0x00, 0x00, 0x02, 0x4C, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0x03, 0xA0, 0xFF, 0xA0, 0xFF, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0x00, 0x00, 0x01, 0x41, 0x99,
+		0x07, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x01, 0x14, 0xCC,
+		0x00, 0x00, 0x00, 0x00, 0x06, 0x00, 0x28, 0x00, 0x02, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 0x61, 0x00, 0x04, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x06, 0x00, 0x89, 0x00, 0x0C, 0xA0, 0xFF, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0xFF, 0x01, 0x07, 0xFF, 0xF2, 0x02, 0x4C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 0x02, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x86, 0x00, 0x04, 0xA0, 0xFF, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 0x32, 0x00, 0x03, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x4D, 0x00, 0x07, 0xA0, 0xFF, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x8B, 0x00, 0x09, 0xA0, 0xFF, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x7F, 0x00, 0x0F, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x04, 0x00, 0x05, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0xFF, 0x00, 0x2E, 0x66, 0x66, 0x02, 0x4C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x09, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x07, 0x00, 0x0F, 0x00, 0x05, 0xA0, 0xFF, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 0x75, 0x00, 0x09, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0xFF, 0x00, 0x47, 0xFF, 0xFE, 0x02, 0x4C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x06, 0x00, 0x0F, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x56, 0x00, 0x01, 0xA0, 0xFF, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0xFF, 0xFF, 0x00, 0x00, 0x02, 0xF8, 0x00, 0x00, 0x01, 0xE2, 0x66, 0x68, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x2F, 0x00, 0x01, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 0x1C, 0x00, 0x06, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x28, 0x00, 0x00, 0x00, 0x34, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x06, 0x00, 0x89, 0x00, 0x02, 0xA0, 0xFF, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x6E, 0x00, 0x08, 0xA0, 0xFF, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 0x1F, 0x00, 0x0F, 0xA0, 0xFF, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0xFF, 0x01, 0x3B, 0x33, 0x22, 0x02, 0x4C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0x00, 0x0F, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x06, 0x00, 0x50, 0x00, 0x0E, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x3D, 0x00, 0x08, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x01, 0x00, 0x0D, 0xA0, 0xFF, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0xFF, 0x00, 0xC7, 0xFF, 0xF6, 0x02, 0x4C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x1F, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 0x4A, 0x00, 0x0A, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x06, 0x00, 0x9B, 0x00, 0x03, 0xA0, 0xFF, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x25, 0x00, 0x0C, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 0x3D, 0x00, 0x0E, 0xA0, 0xFF, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 0x22, 0x00, 0x0D, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x5D, 0x00, 0x07, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x06, 0x00, 0x07, 0x00, 0x0B, 0xA0, 0xFF, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x20, 0x00, 0x06, 0xA0, 0xFF, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x04, 0x00, 0x0B, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0xFF, 0x00, 0xB1, 0x99, 0xBE, 0x02, 0x4C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x56, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x2A, 0x00, 0x11, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 0x26, 0x00, 0x0A, 0xA0, 0xFF, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0xFF, 0x00, 0xA1, 0x99, 0x92, 0x02, 0x4C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x92, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x06, 0x00, 0x02, 0x00, 0x10, 0xA0, 0xFF, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x07, 0x00, 0x38, 0x00, 0x10, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0xFF, 0x00, 0xEE, 0x66, 0x5A, 0x02, 0x4C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x09, 0x00, 0x05, 0x00,
+		0x00, 0xFF, 0xFF, 0x00, 0x00, 0x02, 0xF8, 0x00, 0x00, 0x00, 0x48, 0x66, 0x72, 0x00, 0x33, 0x00,
+		0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x28, 0x00, 0x00, 0x01, 0xA0, 0x66, 0x5E, 0x00, 0x04, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x09, 0x00, 0x2D, 0x00, 0x11, 0xA0, 0xFF, 0xA0, 0xFF, 0x00, 0x00, 0x00,
+		0x00, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x28, 0x00, 0x00, 0x01, 0x7C, 0x00, 0x04, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x01, 0x00, 0x00, 0x02, 0xF8, 0x00, 0x00, 0x00, 0x38, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0xBE, 0xFF, 0xA0, 0xA0, 0xFF, 0x02, 0x58, 0x00, 0x0A, 0x00, 0x0C, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0x93, 0xFF, 0xA0, 0xA0, 0xFF, 0x00, 0x67, 0xFF, 0xFC, 0x00, 0x0C, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0x44, 0xFF, 0xA0, 0xA0, 0xFF, 0x01, 0x34, 0xCC, 0xBC, 0x00, 0x0C, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0xFF, 0x01, 0x47, 0xFF, 0xEE, 0x02, 0x4C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0xB4, 0x00,
+	};
+}
@@ -0,0 +1,140 @@
+#pragma once
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <cstddef>
+
+// cow_vector.h: Copy-on-write vector whose elements are shared between copies
+//				 Copying is O(1); mutate() only duplicates the element written to
+// NOTE: Not thread-safe; a cow_vector and its copies must be used from the same thread
+
+template <typename T>
+class cow_vector
+{
+	using element_ptr = std::shared_ptr<T>;
+	using storage = std::vector<element_ptr>;
+
+public:
+	class const_iterator
+	{
+	public:
+		using iterator_category = std::random_access_iterator_tag;
+		using value_type = T;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const T*;
+		using reference = const T&;
+
+		const_iterator() = default;
+		explicit const_iterator(typename storage::const_iterator it) : mIt(it) {}
+
+		reference operator*() const { return **mIt; }
+		pointer operator->() const { return mIt->get(); }
+		reference operator[](difference_type n) const { return *mIt[n]; }
+
+		const_iterator& operator++() { ++mIt; return *this; }
+		const_iterator operator++(int) { auto tmp = *this; ++mIt; return tmp; }
+		const_iterator& operator--() { --mIt; return *this; }
+		const_iterator operator--(int) { auto tmp = *this; --mIt; return tmp; }
+
+		const_iterator& operator+=(difference_type n) { mIt += n; return *this; }
+		const_iterator& operator-=(difference_type n) { mIt -= n; return *this; }
+		const_iterator operator+(difference_type n) const { return const_iterator(mIt + n); }
+		const_iterator operator-(difference_type n) const { return const_iterator(mIt - n); }
+		friend const_iterator operator+(difference_type n, const const_iterator& it) { return it + n; }
+
+		difference_type operator-(const const_iterator& other) const { return mIt - other.mIt; }
+
+		bool operator==(const const_iterator& other) const { return mIt == other.mIt; }
+		bool operator!=(const const_iterator& other) const { return mIt != other.mIt; }
+		bool operator<(const const_iterator& other) const { return mIt < other.mIt; }
+		bool operator>(const const_iterator& other) const { return mIt > other.mIt; }
+		bool operator<=(const const_iterator& other) const { return mIt <= other.mIt; }
+		bool operator>=(const const_iterator& other) const { return mIt >= other.mIt; }
+
+	private:
+		typename storage::const_iterator mIt;
+	};
+
+	std::size_t size() const { return mStorage ? mStorage->size() : 0; }
+	bool empty() const { return size() == 0; }
+
+	const_iterator begin() const { return const_iterator(mStorage ? mStorage->cbegin() : typename storage::const_iterator()); }
+	const_iterator end() const { return const_iterator(mStorage ? mStorage->cend() : typename storage::const_iterator()); }
+
+	const T& operator[](std::size_t i) const { return *(*mStorage)[i]; }
+	const T& back() const { return *mStorage->back(); }
+
+	// Get a writable reference to element i, duplicating it first if a copy still refers to it
+	T& mutate(std::size_t i)
+	{
+		element_ptr& element = Own()[i];
+		if (element.use_count() > 1)
+			element = std::make_shared<T>(*element);
+
+		return *element;
+	}
+
+	T& push_back(const T& value)
+	{
+		storage& elements = Own();
+		elements.push_back(std::make_shared<T>(value));
+		return *elements.back();
+	}
+
+	// Appends element i of another vector without duplicating it
+	void push_back_shared(const cow_vector& other, std::size_t i)
+	{
+		Own().push_back((*other.mStorage)[i]);
+	}
+
+	void erase(std::size_t i)
+	{
+		storage& elements = Own();
+		elements.erase(elements.begin() + i);
+	}
+
+	// Removes element i by moving the last element into its place (O(1), but does not keep the order)
+	void swap_erase(std::size_t i)
+	{
+		storage& elements = Own();
+		if (i != elements.size() - 1)
+			elements[i] = std::move(elements.back());
+
+		elements.pop_back();
+	}
+
+	// Removes every element matching pred, returns how many were removed
+	template <typename Pred>
+	std::size_t remove_if(Pred pred)
+	{
+		if (empty())
+			return 0;
+
+		storage& elements = Own();
+		auto it = std::remove_if(elements.begin(), elements.end(), [&](const element_ptr& e) { return pred(*e); });
+		std::size_t removed = elements.end() - it;
+		elements.erase(it, elements.end());
+		return removed;
+	}
+
+	void clear() { mStorage.reset(); }
+
+	void reserve(std::size_t n) { Own().reserve(n); }
+
+	// True if both vectors share the same element list (nothing has been written since one was copied from the other)
+	bool shares_storage(const cow_vector& other) const { return mStorage == other.mStorage; }
+
+private:
+	// Make sure no other copy shares our element list before we modify it
+	storage& Own()
+	{
+		if (!mStorage)
+			mStorage = std::make_shared<storage>();
+		else if (mStorage.use_count() > 1)
+			mStorage = std::make_shared<storage>(*mStorage);
+
+		return *mStorage;
+	}
+
+	std::shared_ptr<storage> mStorage;
+};
@@ -0,0 +1,114 @@
+#include <cstdio>
+#include <iostream>
+#include <vector>
+#include "compression.h"
+#include "recording.h"
+using namespace Network;
+
+// Usage: networking-dictionary <recording>... > compression_dictionary.h
+//		  networking-dictionary <recording>... > compression_dictionary_fixed.h (NETWORKING_DETERMINISTIC builds)
+// Trains the preset dictionary for compression.h on the state updates of recorded matches (see recording.h),
+// and writes it out as a header. Fixed-point builds lay positions out differently, so they have a dictionary of their
+// own; it is trained by a build with the same setting, on recordings made by one
+// The dictionary goes to stdout, so everything else goes to stderr
+
+#ifdef NETWORKING_DETERMINISTIC
+constexpr char HEADER_NAME[] = "compression_dictionary_fixed.h";
+#else
+constexpr char HEADER_NAME[] = "compression_dictionary.h";
+#endif
+
+constexpr std::size_t DICTIONARY_SIZE = 1024;
+
+// The server records its state this often; updates go out no more often than that either
+constexpr sf::Uint64 SAMPLE_INTERVAL_US = 50000;
+
+// Only every few updates are trained on; the rest are what the dictionary is measured against
+constexpr std::size_t TRAINING_STRIDE = 4;
+
+int main(int argc, const char* argv[])
+{
+	if (argc < 2)
+	{
+		std::cerr << "Usage: " << argv[0] << " <recording>... > " << HEADER_NAME << std::endl;
+		return 1;
+	}
+
+	// Packets are only compressed once they are large, and complete updates (spectators, relays, resyncs) are
+	// the large ones, so those are what is trained on: each recorded state, encoded as the server would send it
+	std::vector<std::vector<sf::Uint8>> updates;
+	for (int i = 1; i < argc; ++i)
+	{
+		Recording::Reader reader;
+		if (!reader.Open(argv[i]))
+		{
+			std::cerr << "Could not open " << argv[i] << std::endl;
+			return 1;
+		}
+
+		reader.Seek(reader.GetStartTime());
+		for (sf::Uint64 time = reader.GetStartTime(); reader.Advance(time); time += SAMPLE_INTERVAL_US)
+		{
+			Message<PACKET_SERVER_UPDATE> msg;
+			msg.snapshot = reader.GetSnapshot();
+			msg.complete = true;
+
+			updates.emplace_back();
+			EncodeTo(updates.back(), msg);
+		}
+	}
+
+	std::vector<std::vector<sf::Uint8>> samples;
+	std::vector<std::vector<sf::Uint8>> tests;
+	for (std::size_t i = 0; i < updates.size(); ++i)
+		(i % TRAINING_STRIDE == 0 ? samples : tests).push_back(updates[i]);
+
+	if (samples.empty())
+	{
+		std::cerr << "No state updates to train on" << std::endl;
+		return 1;
+	}
+
+	std::vector<sf::Uint8> dictionary = Compression::TrainDictionary(samples, DICTIONARY_SIZE);
+
+	std::printf("#pragma once\n"
+				"#include <SFML/System.hpp>\n"
+				"\n"
+				"// %s: Preset dictionary for compression.h%s\n"
+				"//\t\t\t\t\t\t\t Generated by networking-dictionary (dictionary_main.cpp) from recorded matches; run it again\n"
+				"//\t\t\t\t\t\t\t on recordings made with the current build to regenerate it. Both ends must use the same\n"
+				"//\t\t\t\t\t\t\t dictionary, so changing it (or the layout of state updates) needs a new compression\n"
+				"//\t\t\t\t\t\t\t capability bit (see CAPABILITY_COMPRESSION_V2 in protocol.h)\n"
+				"\n"
+				"namespace Compression\n"
+				"{\n"
+				"\tconstexpr sf::Uint8 DICTIONARY[] = {", HEADER_NAME,
+#ifdef NETWORKING_DETERMINISTIC
+				", in builds with NETWORKING_DETERMINISTIC"
+#else
+				""
+#endif
+				);
+
+	for (std::size_t i = 0; i < dictionary.size(); ++i)
+		std::printf("%s0x%02X,", (i % 16 == 0) ? "\n\t\t" : " ", dictionary[i]);
+
+	std::printf("\n\t};\n}\n");
+
+	// How well the dictionary built into this binary does on the updates that were not trained on
+	std::size_t original = 0;
+	std::size_t compressed = 0;
+	for (const auto& update : tests)
+	{
+		std::vector<sf::Uint8> out;
+		original += update.size();
+		compressed += Compression::Compress(update.data(), update.size(), out) ? out.size() : update.size();
+	}
+
+	std::cerr << "Trained a " << dictionary.size() << " byte dictionary on " << samples.size() << " of " << updates.size() << " state updates";
+	if (original > 0)
+		std::cerr << "; the one built in compresses the rest to " << (100 * compressed / original) << "% of their size";
+	std::cerr << std::endl;
+
+	return 0;
+}
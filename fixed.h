@@ -0,0 +1,73 @@
+#pragma once
+#include <SFML/System.hpp>
+#include <chrono>
+
+// fixed.h: The number type the simulation (World, Player and Bullet) is written in
+//			By default that is float. Built with NETWORKING_DETERMINISTIC (the CMake option of the same name), it is
+//			Fixed instead, a 16.16 fixed-point number: integer maths gives bit-identical results on every machine and
+//			compiler, so a client's prediction and the server agree exactly given the same commands, and so do replays.
+// NOTE: Positions go on the wire as Scalars, so clients, servers, relays and recordings must all be built the same way
+
+class Fixed
+{
+public:
+	static constexpr int FRACTION_BITS = 16;
+	static constexpr sf::Int32 ONE = sf::Int32(1) << FRACTION_BITS;
+
+	constexpr Fixed() = default;
+	constexpr explicit Fixed(int v) : mRaw(v * ONE) {}
+	// Rounds to the nearest step; converting the same float always gives the same Fixed
+	constexpr explicit Fixed(float v) : mRaw(sf::Int32(v * ONE + (v < 0.f ? -0.5f : 0.5f))) {}
+
+	static constexpr Fixed FromRaw(sf::Int32 raw) { Fixed f; f.mRaw = raw; return f; }
+	constexpr sf::Int32 GetRaw() const { return mRaw; }
+
+	// For drawing, and anything else outside the simulation
+	constexpr explicit operator float() const { return float(mRaw) / ONE; }
+
+	constexpr Fixed operator-() const { return FromRaw(-mRaw); }
+
+	constexpr Fixed operator+(Fixed other) const { return FromRaw(mRaw + other.mRaw); }
+	constexpr Fixed operator-(Fixed other) const { return FromRaw(mRaw - other.mRaw); }
+	constexpr Fixed operator*(Fixed other) const { return FromRaw(sf::Int32((sf::Int64(mRaw) * other.mRaw) >> FRACTION_BITS)); }
+	constexpr Fixed operator/(Fixed other) const { return FromRaw(sf::Int32((sf::Int64(mRaw) << FRACTION_BITS) / other.mRaw)); }
+
+	Fixed& operator+=(Fixed other) { return *this = *this + other; }
+	Fixed& operator-=(Fixed other) { return *this = *this - other; }
+	Fixed& operator*=(Fixed other) { return *this = *this * other; }
+	Fixed& operator/=(Fixed other) { return *this = *this / other; }
+
+	constexpr bool operator==(Fixed other) const { return mRaw == other.mRaw; }
+	constexpr bool operator!=(Fixed other) const { return mRaw != other.mRaw; }
+	constexpr bool operator<(Fixed other) const { return mRaw < other.mRaw; }
+	constexpr bool operator>(Fixed other) const { return mRaw > other.mRaw; }
+	constexpr bool operator<=(Fixed other) const { return mRaw <= other.mRaw; }
+	constexpr bool operator>=(Fixed other) const { return mRaw >= other.mRaw; }
+
+private:
+	sf::Int32 mRaw = 0;
+};
+
+#ifdef NETWORKING_DETERMINISTIC
+using Scalar = Fixed;
+#else
+using Scalar = float;
+#endif
+
+using Vector = sf::Vector2<Scalar>;
+
+// Converting to and from the float vectors SFML draws with (no-ops unless the simulation is fixed-point)
+inline sf::Vector2f ToFloat(const Vector& v) { return sf::Vector2f(v); }
+inline Vector ToVector(const sf::Vector2f& v) { return Vector(v); }
+
+// How far something moving at 'speed' units per second goes in 'dt'
+// Fixed-point multiplies before dividing, in 64 bits, so long steps neither overflow nor lose precision
+template<typename Rep, typename Period>
+Scalar DistanceIn(Scalar speed, std::chrono::duration<Rep, Period> dt)
+{
+#ifdef NETWORKING_DETERMINISTIC
+	return Fixed::FromRaw(sf::Int32(sf::Int64(speed.GetRaw()) * sf::Int64(dt.count()) * Period::num / Period::den));
+#else
+	return speed * float(dt.count()) * Period::num / Period::den;
+#endif
+}
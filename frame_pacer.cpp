@@ -0,0 +1,30 @@
+#include "frame_pacer.h"
+
+namespace Network
+{
+	void FramePacer::Start(time_point now)
+	{
+		mLastFrame = now;
+		mAccumulated = the_clock::duration(0);
+	}
+
+	int FramePacer::Advance(time_point now)
+	{
+		// Kept in the clock's own units, so no time is lost to rounding
+		mAccumulated += now - mLastFrame;
+		mLastFrame = now;
+
+		auto steps = mAccumulated / mStep;
+		mAccumulated -= steps * std::chrono::duration_cast<the_clock::duration>(mStep);
+
+		if (steps > mMaxSteps)
+			steps = mMaxSteps;
+
+		return int(steps);
+	}
+
+	float FramePacer::GetAlpha() const
+	{
+		return std::chrono::duration<float>(mAccumulated) / std::chrono::duration<float>(mStep);
+	}
+}
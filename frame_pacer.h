@@ -0,0 +1,29 @@
+#pragma once
+#include "common.h"
+
+// frame_pacer.h: Runs the simulation at a fixed rate, whatever rate frames are drawn at
+//				  After a stall only a few steps are caught up, and the rest of the time is dropped
+
+namespace Network
+{
+	class FramePacer
+	{
+	public:
+		FramePacer(ms step, int maxStepsPerFrame) : mStep(step), mMaxSteps(maxStepsPerFrame) {}
+
+		void Start(time_point now);
+
+		// Moves on to 'now', and returns the number of steps to run this frame
+		int Advance(time_point now);
+
+		ms GetStep() const { return mStep; }
+		// How far the frame is from the last step to the next, 0 to 1
+		float GetAlpha() const;
+
+	private:
+		ms mStep;
+		int mMaxSteps;
+		time_point mLastFrame;
+		the_clock::duration mAccumulated{ 0 };
+	};
+}
@@ -0,0 +1,286 @@
+#include "handoff.h"
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+#include "debug.h"
+
+namespace Network
+{
+	namespace Handoff
+	{
+		namespace
+		{
+			std::atomic<bool> gIsRequested{ false };
+
+			// Sent by the new process once it has loaded the checkpoint, and by the old one in answer, once it will stop
+			constexpr char ACKNOWLEDGED = 1;
+			constexpr char COMMITTED = 2;
+
+#ifndef _WIN32
+			void OnSignal(int)
+			{
+				gIsRequested = true;
+			}
+
+			bool MakeAddress(const std::string& path, sockaddr_un& address)
+			{
+				if (path.size() >= sizeof(address.sun_path))
+				{
+					debug << "HANDOFF: Socket path is too long: " << path << std::endl;
+					return false;
+				}
+
+				std::memset(&address, 0, sizeof(address));
+				address.sun_family = AF_UNIX;
+				std::strcpy(address.sun_path, path.c_str());
+				return true;
+			}
+
+			bool WaitFor(int fd, short events, int timeoutMs)
+			{
+				pollfd p{ fd, events, 0 };
+				return poll(&p, 1, timeoutMs) == 1;
+			}
+
+			bool WriteAll(int fd, const void* data, std::size_t size)
+			{
+				const char* bytes = static_cast<const char*>(data);
+				while (size > 0)
+				{
+					ssize_t n = send(fd, bytes, size, MSG_NOSIGNAL);
+					if (n <= 0)
+						return false;
+
+					bytes += n;
+					size -= n;
+				}
+
+				return true;
+			}
+
+			bool ReadAll(int fd, void* data, std::size_t size, int timeoutMs)
+			{
+				char* bytes = static_cast<char*>(data);
+				while (size > 0)
+				{
+					if (!WaitFor(fd, POLLIN, timeoutMs))
+						return false;
+
+					ssize_t n = recv(fd, bytes, size, 0);
+					if (n <= 0)
+						return false;
+
+					bytes += n;
+					size -= n;
+				}
+
+				return true;
+			}
+
+			// One handle per message, each with a single byte to carry it
+			bool SendHandle(int fd, sf::SocketHandle handle)
+			{
+				char byte = 0;
+				iovec io{ &byte, 1 };
+
+				alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+
+				msghdr msg{};
+				msg.msg_iov = &io;
+				msg.msg_iovlen = 1;
+				msg.msg_control = control;
+				msg.msg_controllen = sizeof(control);
+
+				cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+				cmsg->cmsg_level = SOL_SOCKET;
+				cmsg->cmsg_type = SCM_RIGHTS;
+				cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+
+				int h = handle;
+				std::memcpy(CMSG_DATA(cmsg), &h, sizeof(int));
+
+				return sendmsg(fd, &msg, MSG_NOSIGNAL) == 1;
+			}
+
+			bool ReceiveHandle(int fd, sf::SocketHandle& handle)
+			{
+				if (!WaitFor(fd, POLLIN, ACK_TIMEOUT_MS))
+					return false;
+
+				char byte;
+				iovec io{ &byte, 1 };
+
+				alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+
+				msghdr msg{};
+				msg.msg_iov = &io;
+				msg.msg_iovlen = 1;
+				msg.msg_control = control;
+				msg.msg_controllen = sizeof(control);
+
+				if (recvmsg(fd, &msg, 0) != 1)
+					return false;
+
+				cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+				if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+					return false;
+
+				int h;
+				std::memcpy(&h, CMSG_DATA(cmsg), sizeof(int));
+				handle = h;
+				return true;
+			}
+#endif
+		}
+
+#ifndef _WIN32
+		Receiver::~Receiver()
+		{
+			if (mPeer >= 0)
+				close(mPeer);
+
+			if (mListener >= 0)
+			{
+				close(mListener);
+				unlink(mPath.c_str());
+			}
+		}
+
+		bool Receiver::Listen(const std::string& socketPath)
+		{
+			sockaddr_un address;
+			if (!MakeAddress(socketPath, address))
+				return false;
+
+			// A socket file left behind by an earlier handoff
+			unlink(socketPath.c_str());
+
+			mListener = socket(AF_UNIX, SOCK_STREAM, 0);
+			if (mListener < 0 || bind(mListener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(mListener, 1) != 0)
+			{
+				debug << "HANDOFF: Could not listen at " << socketPath << ": " << std::strerror(errno) << std::endl;
+				return false;
+			}
+
+			mPath = socketPath;
+			debug << "HANDOFF: Waiting at " << socketPath << " for the running server to hand over" << std::endl;
+			return true;
+		}
+
+		bool Receiver::Receive(std::vector<sf::SocketHandle>& handles)
+		{
+			if (!WaitFor(mListener, POLLIN, ACCEPT_TIMEOUT_MS))
+			{
+				debug << "HANDOFF: The running server never handed over" << std::endl;
+				return false;
+			}
+
+			mPeer = accept(mListener, nullptr, nullptr);
+			if (mPeer < 0)
+				return false;
+
+			sf::Uint32 count;
+			if (!ReadAll(mPeer, &count, sizeof(count), ACK_TIMEOUT_MS))
+				return false;
+
+			handles.clear();
+			for (sf::Uint32 i = 0; i < count; ++i)
+			{
+				sf::SocketHandle handle;
+				if (!ReceiveHandle(mPeer, handle))
+				{
+					debug << "HANDOFF: Lost the running server after " << i << " of " << count << " sockets" << std::endl;
+
+					for (sf::SocketHandle h : handles)
+						close(h);
+
+					handles.clear();
+					return false;
+				}
+
+				handles.push_back(handle);
+			}
+
+			return true;
+		}
+
+		bool Receiver::Acknowledge()
+		{
+			char commit = 0;
+			if (!WriteAll(mPeer, &ACKNOWLEDGED, 1) || !ReadAll(mPeer, &commit, 1, ACK_TIMEOUT_MS) || commit != COMMITTED)
+			{
+				debug << "HANDOFF: The running server did not let go" << std::endl;
+				return false;
+			}
+
+			return true;
+		}
+
+		bool SendHandles(const std::string& socketPath, const std::vector<sf::SocketHandle>& handles)
+		{
+			sockaddr_un address;
+			if (!MakeAddress(socketPath, address))
+				return false;
+
+			int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+			if (fd < 0)
+				return false;
+
+			if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+			{
+				debug << "HANDOFF: Nothing is waiting to take over at " << socketPath << std::endl;
+				close(fd);
+				return false;
+			}
+
+			sf::Uint32 count = sf::Uint32(handles.size());
+			bool isSent = WriteAll(fd, &count, sizeof(count));
+
+			for (std::size_t i = 0; isSent && i < handles.size(); ++i)
+				isSent = SendHandle(fd, handles[i]);
+
+			// Past the commit, the new process ticks; if it is not told, it gives up and this one carries on
+			char ack = 0;
+			bool isAcknowledged = isSent && ReadAll(fd, &ack, 1, ACK_TIMEOUT_MS) && ack == ACKNOWLEDGED && WriteAll(fd, &COMMITTED, 1);
+
+			close(fd);
+
+			if (!isAcknowledged)
+				debug << "HANDOFF: The new server did not take over" << std::endl;
+
+			return isAcknowledged;
+		}
+
+		void InstallSignalHandler()
+		{
+			std::signal(SIGUSR2, OnSignal);
+		}
+#else
+		Receiver::~Receiver() {}
+
+		bool Receiver::Listen(const std::string&)
+		{
+			debug << "HANDOFF: Hot restart is not supported on this platform" << std::endl;
+			return false;
+		}
+
+		bool Receiver::Receive(std::vector<sf::SocketHandle>&) { return false; }
+		bool Receiver::Acknowledge() { return false; }
+
+		bool SendHandles(const std::string&, const std::vector<sf::SocketHandle>&) { return false; }
+		void InstallSignalHandler() {}
+#endif
+
+		bool IsRequested()
+		{
+			return gIsRequested.exchange(false);
+		}
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <SFML/Network.hpp>
+#include <string>
+#include <vector>
+#include "common.h"
+
+// handoff.h: Passing a running server's sockets on to the process that replaces it (hot restart)
+//			  The old process sends its sockets over a Unix domain socket; only one of the two ever keeps ticking
+// NOTE: Not supported on Windows
+
+namespace Network
+{
+	namespace Handoff
+	{
+		constexpr char DEFAULT_SOCKET_PATH[] = "server.handoff";
+		constexpr char DEFAULT_CHECKPOINT_PATH[] = "server.checkpoint";
+
+		// How long either side waits for the other
+		constexpr int ACCEPT_TIMEOUT_MS = 60000;
+		constexpr int ACK_TIMEOUT_MS = 5000;
+
+		// New process: listens at 'socketPath', ready for the old process to connect
+		class Receiver
+		{
+		public:
+			~Receiver();
+
+			bool Listen(const std::string& socketPath);
+
+			// Waits for the old process, and receives its handles
+			bool Receive(std::vector<sf::SocketHandle>& handles);
+
+			// Tells the old process to stop, and waits until it has
+			// Returns false if it is still running, in which case the handles must not be used
+			bool Acknowledge();
+
+		private:
+			int mListener = -1;
+			int mPeer = -1;
+			std::string mPath;
+		};
+
+		// Old process: sends 'handles' to the process waiting at 'socketPath'
+		// Returns true once the new process has taken over, after which this one must stop
+		bool SendHandles(const std::string& socketPath, const std::vector<sf::SocketHandle>& handles);
+
+		// Makes the next call to IsRequested return true when the process receives SIGUSR2
+		void InstallSignalHandler();
+		// True once, after a handoff is requested
+		bool IsRequested();
+	}
+}
@@ -0,0 +1,82 @@
+#include "histogram.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace Network
+{
+	void LatencyHistogram::Record(sf::Uint64 value)
+	{
+		value = std::min(value, MAX_VALUE);
+
+		++mCounts[GetIndex(value)];
+		++mCount;
+		mMax = std::max(mMax, value);
+	}
+
+	void LatencyHistogram::Merge(const LatencyHistogram& other)
+	{
+		for (std::size_t i = 0; i < BUCKET_COUNT; ++i)
+			mCounts[i] += other.mCounts[i];
+
+		mCount += other.mCount;
+		mMax = std::max(mMax, other.mMax);
+	}
+
+	void LatencyHistogram::Reset()
+	{
+		mCounts.fill(0);
+		mCount = 0;
+		mMax = 0;
+	}
+
+	sf::Uint64 LatencyHistogram::GetPercentile(double p) const
+	{
+		if (mCount == 0)
+			return 0;
+
+		// The rank of the sample we are after, counting from 1
+		sf::Uint64 rank = std::max(sf::Uint64(1), sf::Uint64(std::ceil(std::min(std::max(p, 0.), 1.) * mCount)));
+
+		sf::Uint64 seen = 0;
+		for (std::size_t i = 0; i < BUCKET_COUNT; ++i)
+		{
+			seen += mCounts[i];
+			if (seen >= rank)
+				return std::min(GetHighestValue(i), mMax);
+		}
+
+		return mMax;
+	}
+
+	std::string LatencyHistogram::Describe() const
+	{
+		char text[128];
+		std::snprintf(text, sizeof(text), "p50 %.2fms  p99 %.2fms  p999 %.2fms  max %.2fms  (%llu samples)",
+			GetPercentile(0.5) / 1000., GetPercentile(0.99) / 1000., GetPercentile(0.999) / 1000., mMax / 1000., (unsigned long long) mCount);
+		return text;
+	}
+
+	std::size_t LatencyHistogram::GetIndex(sf::Uint64 value)
+	{
+		if (value < SUB_BUCKET_COUNT)
+			return std::size_t(value);
+
+		// Shift the value down until it lands in the top half of the sub-buckets; each shift is another power of two
+		int shift = 0;
+		while ((value >> shift) >= SUB_BUCKET_COUNT)
+			++shift;
+
+		return std::size_t(SUB_BUCKET_COUNT + (shift - 1) * HALF_BUCKET_COUNT + ((value >> shift) - HALF_BUCKET_COUNT));
+	}
+
+	sf::Uint64 LatencyHistogram::GetHighestValue(std::size_t index)
+	{
+		if (index < SUB_BUCKET_COUNT)
+			return index;
+
+		int shift = int((index - SUB_BUCKET_COUNT) / HALF_BUCKET_COUNT) + 1;
+		sf::Uint64 subBucket = (index - SUB_BUCKET_COUNT) % HALF_BUCKET_COUNT + HALF_BUCKET_COUNT;
+		return ((subBucket + 1) << shift) - 1;
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <SFML/System.hpp>
+#include <algorithm>
+#include <array>
+#include <string>
+#include "common.h"
+
+// histogram.h: Latency histogram, HdrHistogram style: O(1) to record, percentiles within about 1.6%
+//				Values are in microseconds
+
+namespace Network
+{
+	class LatencyHistogram
+	{
+	public:
+		void Record(sf::Uint64 value);
+		void Record(us value) { Record(sf::Uint64(std::max(value.count(), us::rep(0)))); }
+
+		void Merge(const LatencyHistogram& other);
+		void Reset();
+
+		sf::Uint64 GetCount() const { return mCount; }
+		sf::Uint64 GetMax() const { return mMax; }
+
+		// The value that a fraction p (0 to 1) of the samples are at or below; 0 if there are none
+		sf::Uint64 GetPercentile(double p) const;
+
+		// p50, p99, p999 and max, in milliseconds, for the log
+		std::string Describe() const;
+
+	private:
+		// Values below 2^SUB_BUCKET_BITS get a bucket each; above that, every power of two is split into half as many
+		static constexpr int SUB_BUCKET_BITS = 7;
+		static constexpr sf::Uint64 SUB_BUCKET_COUNT = sf::Uint64(1) << SUB_BUCKET_BITS;
+		static constexpr sf::Uint64 HALF_BUCKET_COUNT = SUB_BUCKET_COUNT / 2;
+		static constexpr int MAX_VALUE_BITS = 32;
+		static constexpr sf::Uint64 MAX_VALUE = (sf::Uint64(1) << MAX_VALUE_BITS) - 1;
+		static constexpr std::size_t BUCKET_COUNT = SUB_BUCKET_COUNT + (MAX_VALUE_BITS - SUB_BUCKET_BITS) * HALF_BUCKET_COUNT;
+
+		static std::size_t GetIndex(sf::Uint64 value);
+		// The largest value that is counted in bucket 'index'
+		static sf::Uint64 GetHighestValue(std::size_t index);
+
+		std::array<sf::Uint32, BUCKET_COUNT> mCounts{};
+		sf::Uint64 mCount = 0;
+		sf::Uint64 mMax = 0;
+	};
+}
@@ -0,0 +1,89 @@
+#include "jitter_buffer.h"
+#include <algorithm>
+#include <cmath>
+
+namespace Network
+{
+	namespace
+	{
+		// Smoothing factors; jitter is smoothed as in RTP (RFC 3550)
+		constexpr float TRANSIT_SMOOTHING = 0.125f;
+		constexpr float JITTER_SMOOTHING = 0.0625f;
+		constexpr float SPACING_SMOOTHING = 0.125f;
+
+		// How many times the jitter to keep in hand
+		constexpr float JITTER_MARGIN = 3.f;
+
+		// The render clock runs at most this much faster or slower than real time...
+		constexpr float MAX_DILATION = 0.1f;
+		// ...and reaches the largest dilation when it is this far off the target delay
+		constexpr float FULL_DILATION_ERROR_US = 50000.f;
+
+		// Further off than this (e.g. after a stall), the render clock jumps instead
+		constexpr sf::Int64 RESYNC_LIMIT_US = 1000000;
+	}
+
+	void JitterBuffer::SetUpdateInterval(ms interval)
+	{
+		if (mLastServerTime == 0)
+			mSpacing = (float) us(interval).count();
+	}
+
+	void JitterBuffer::OnSnapshot(sf::Uint64 serverTime, sf::Uint64 arrivalTime)
+	{
+		// Older than one we already have
+		if (serverTime <= mLastServerTime)
+			return;
+
+		// Subtracted before converting, since a float cannot hold times this large to the microsecond
+		float transit = (float) (sf::Int64(arrivalTime) - sf::Int64(serverTime));
+
+		if (mLastServerTime == 0)
+			mTransit = transit;
+		else
+		{
+			mTransit += (transit - mTransit) * TRANSIT_SMOOTHING;
+			mJitter += (std::fabs(transit - mLastTransit) - mJitter) * JITTER_SMOOTHING;
+			mSpacing += ((float) (serverTime - mLastServerTime) - mSpacing) * SPACING_SMOOTHING;
+		}
+
+		mLastTransit = transit;
+		mLastServerTime = serverTime;
+	}
+
+	us JitterBuffer::GetTargetDelay() const
+	{
+		float delay = std::max(mTransit, 0.f) + mSpacing + JITTER_MARGIN * mJitter;
+		return us(sf::Int64(delay));
+	}
+
+	sf::Uint64 JitterBuffer::Advance(sf::Uint64 now)
+	{
+		sf::Int64 target = GetTargetDelay().count();
+
+		if (!mIsStarted)
+		{
+			mRenderTime = (now > sf::Uint64(target)) ? now - target : 0;
+			mLastNow = now;
+			mIsStarted = true;
+		}
+
+		sf::Int64 elapsed = sf::Int64(now) - sf::Int64(mLastNow);
+		mLastNow = now;
+
+		// How far off the target delay we would be running at normal speed
+		sf::Int64 error = (sf::Int64(now) - sf::Int64(mRenderTime + std::max<sf::Int64>(elapsed, 0))) - target;
+
+		if (std::llabs(error) > RESYNC_LIMIT_US)
+			mRenderTime = (now > sf::Uint64(target)) ? now - target : 0;
+		else if (elapsed > 0)
+		{
+			// Behind: run faster, ahead: run slower
+			float dilation = std::min(std::max((float) error / FULL_DILATION_ERROR_US, -1.f), 1.f) * MAX_DILATION;
+			mRenderTime += sf::Uint64(elapsed * (1.f + dilation));
+		}
+
+		mDelay = us(sf::Int64(now) - sf::Int64(mRenderTime));
+		return mRenderTime;
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <SFML/System.hpp>
+#include "common.h"
+
+// jitter_buffer.h: Chooses how far in the past the client renders other entities
+//					The delay is transit, plus the time between snapshots, plus a margin for jitter; the render
+//					clock eases towards it rather than jumping. Times are microseconds on the server's clock
+
+namespace Network
+{
+	class JitterBuffer
+	{
+	public:
+		// The server's update interval, until the spacing between snapshots has been measured
+		void SetUpdateInterval(ms interval);
+
+		// A snapshot stamped 'serverTime' arrived at 'arrivalTime'
+		void OnSnapshot(sf::Uint64 serverTime, sf::Uint64 arrivalTime);
+
+		// Moves the render clock on to 'now' and returns the time to render
+		sf::Uint64 Advance(sf::Uint64 now);
+
+		// Starts the render clock over on the next Advance, for when the clock 'now' is read from has jumped
+		void Restart() { mIsStarted = false; }
+
+		sf::Uint64 GetRenderTime() const { return mRenderTime; }
+		us GetDelay() const { return mDelay; }
+		us GetTargetDelay() const;
+
+	private:
+		// Smoothed estimates
+		float mTransit = 0.f;
+		float mJitter = 0.f;
+		float mSpacing = 50000.f;
+
+		float mLastTransit = 0.f;
+		sf::Uint64 mLastServerTime = 0;
+
+		// Render clock
+		bool mIsStarted = false;
+		sf::Uint64 mRenderTime = 0;
+		sf::Uint64 mLastNow = 0;
+		us mDelay{ 0 };
+	};
+}
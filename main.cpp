@@ -4,11 +4,13 @@
 
 #include "server.h"
 #include "client.h"
+#include "playback.h"
 #include "debug.h"
 using namespace Network;
 
 constexpr char DEFAULT_IP[] = "127.0.0.1";
 constexpr Port DEFAULT_PORT = 11223;
+constexpr char DEFAULT_RECORDING[] = "match.rec";
 
 int main(int argc, const char* argv[])
 {
@@ -31,28 +33,39 @@ int main(int argc, const char* argv[])
 
 	debug << "Y: Host new game\n" <<
 			"N: Join game in progress\n" << 
-			"D: Run as dedicated server" << std::endl;
+			"R: Host new game and record it to " << DEFAULT_RECORDING << "\n" <<
+			"P: Play back a recording" << std::endl;
 
 	char input{};
 	std::cin >> input;
 
 	input = tolower(input);
 
-	bool isHost = (input == 'y');
-	bool isDedicated = (input == 'd');
+	if (input == 'p')
+	{
+		debug << "Recording to play back: " << std::endl;
+
+		std::string path;
+		std::cin >> path;
+
+		return Playback::PlayRecording(path) ? 0 : 1;
+	}
+
+	// Dedicated servers are a build of their own (networking-server, see server_main.cpp)
+	bool isHost = (input == 'y' || input == 'r');
+
+	if (input == 'r')
+		Server::SetRecordingPath(DEFAULT_RECORDING);
 
 	// Start server in separate thread
 	if (isHost)
 		Server::StartServer({ serverip }, serverport);
 
-	// Start server in main thread
-	if (isDedicated)
-		Server::ServerTask({ serverip }, serverport);
 	// Start client
-	else
-		Client::StartClient({ serverip }, serverport);
+	Client::StartClient({ serverip }, serverport);
 
-	// Join server thread	if (isHost)
+	// Join server thread
+	if (isHost)
 		Server::CloseServer();
 
 	return 0;
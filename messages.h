@@ -0,0 +1,180 @@
+#pragma once
+#include "protocol.h"
+#include "world.h"
+#include "command.h"
+
+// messages.h: The contents of every packet type
+//			   Each Message lists its fields once in Fields(); see protocol.h for how they are encoded
+
+namespace Network
+{
+	template<>
+	struct Message<PACKET_CLIENT_JOIN>
+	{
+		static constexpr Direction DIRECTION = TO_SERVER;
+
+		sf::Uint32 version = PROTOCOL_VERSION;			// The protocol the client speaks (see PROTOCOL_VERSION)
+		bool relay = false;								// Set by relays, which re-broadcast the game to their own spectators
+		Trailing<sf::Uint8> capabilities;				// Capability flags the client supports
+		Trailing<std::vector<sf::Uint8>> relayKey;		// The secret a relay proves it is one with (see Server::SetRelayKey)
+
+		static constexpr auto Fields() { return std::make_tuple(&Message::version, &Message::relay, &Message::capabilities, &Message::relayKey); }
+	};
+
+	template<>
+	struct Message<PACKET_SERVER_WELCOME>
+	{
+		static constexpr Direction DIRECTION = TO_CLIENT;
+
+		EntityID pid;						// The client's player id
+		float rotation;						// How many degrees the client should rotate their view by
+		Trailing<sf::Uint8> capabilities;	// The capabilities the server agreed to (only if the client asked for any)
+
+		static constexpr auto Fields() { return std::make_tuple(&Message::pid, &Message::rotation, &Message::capabilities); }
+	};
+
+	template<>
+	struct Message<PACKET_SERVER_SPECTATOR>
+	{
+		static constexpr Direction DIRECTION = TO_CLIENT;
+
+		Trailing<sf::Uint8> capabilities;	// The capabilities the server agreed to (only if the client asked for any)
+
+		static constexpr auto Fields() { return std::make_tuple(&Message::capabilities); }
+	};
+
+	template<>
+	struct Message<PACKET_SERVER_FULL>
+	{
+		static constexpr Direction DIRECTION = TO_CLIENT;
+
+		static constexpr auto Fields() { return std::make_tuple(); }
+	};
+
+	template<>
+	struct Message<PACKET_CLIENT_CMD>
+	{
+		static constexpr Direction DIRECTION = TO_SERVER;
+
+		Command cmd;
+		Trailing<sf::Uint64> inputTime;	// When the command was input, on the server's clock (only with CAPABILITY_INPUT_TIMES)
+
+		static constexpr auto Fields() { return std::make_tuple(&Message::cmd, &Message::inputTime); }
+	};
+
+	template<>
+	struct Message<PACKET_SERVER_PING>
+	{
+		static constexpr Direction DIRECTION = TO_CLIENT;
+
+		sf::Uint64 serverTime;	// When the server sent the request
+
+		static constexpr auto Fields() { return std::make_tuple(&Message::serverTime); }
+	};
+
+	template<>
+	struct Message<PACKET_CLIENT_PING>
+	{
+		static constexpr Direction DIRECTION = TO_SERVER;
+
+		sf::Uint64 serverTime;	// The server's timestamp from its ping request
+		sf::Uint64 clientTime;	// The client's own clock, which the server sends back
+
+		static constexpr auto Fields() { return std::make_tuple(&Message::serverTime, &Message::clientTime); }
+	};
+
+	template<>
+	struct Message<PACKET_SERVER_CLOCK>
+	{
+		static constexpr Direction DIRECTION = TO_CLIENT;
+
+		sf::Uint64 clientTime;	// The client's clock from its ping response
+		sf::Uint64 serverTime;	// When the server answered
+
+		static constexpr auto Fields() { return std::make_tuple(&Message::clientTime, &Message::serverTime); }
+	};
+
+	template<>
+	struct Message<PACKET_SERVER_UPDATE>
+	{
+		static constexpr Direction DIRECTION = TO_CLIENT;
+
+		WorldSnapshot snapshot;
+		bool complete;					// False if some bullets were left out, to keep within the connection's byte budget or because the client has them
+		Trailing<sf::Uint32> checksum;	// Of every bullet the server has, sent or not (only with CAPABILITY_CHECKSUMS)
+
+		static constexpr auto Fields() { return std::make_tuple(&Message::snapshot, &Message::complete, &Message::checksum); }
+	};
+
+	template<>
+	struct Message<PACKET_CLIENT_SHOOT>
+	{
+		static constexpr Direction DIRECTION = TO_SERVER;
+
+		sf::Uint64 serverTime;				// When the client fired, converted to the server's clock
+		Trailing<sf::Uint32> spawnToken;	// Names the bullet the client predicted (only with CAPABILITY_SPAWN_TOKENS)
+
+		static constexpr auto Fields() { return std::make_tuple(&Message::serverTime, &Message::spawnToken); }
+	};
+
+	template<>
+	struct Message<PACKET_SERVER_SHOOT>
+	{
+		static constexpr Direction DIRECTION = TO_CLIENT;
+
+		Bullet bullet;
+		sf::Uint64 serverTime;				// Timestamp of when the bullet was spawned
+		Trailing<sf::Uint32> spawnToken;	// Only sent back to the shooter: the token from its PACKET_CLIENT_SHOOT
+
+		static constexpr auto Fields() { return std::make_tuple(&Message::bullet, &Message::serverTime, &Message::spawnToken); }
+	};
+
+	template<>
+	struct Message<PACKET_CLIENT_ACK>
+	{
+		static constexpr Direction DIRECTION = TO_SERVER;
+
+		sf::Uint64 serverTime;	// Timestamp of the newest snapshot received
+
+		static constexpr auto Fields() { return std::make_tuple(&Message::serverTime); }
+	};
+
+	template<>
+	struct Message<PACKET_SERVER_RATE>
+	{
+		static constexpr Direction DIRECTION = TO_CLIENT;
+
+		sf::Uint16 updateInterval;	// Milliseconds between state updates
+
+		static constexpr auto Fields() { return std::make_tuple(&Message::updateInterval); }
+	};
+
+	template<>
+	struct Message<PACKET_SERVER_BACKLOG>
+	{
+		static constexpr Direction DIRECTION = TO_CLIENT;
+
+		std::vector<WorldSnapshot> snapshots;	// Oldest first; only the newest one holds bullets
+
+		static constexpr auto Fields() { return std::make_tuple(&Message::snapshots); }
+	};
+
+	template<>
+	struct Message<PACKET_CLIENT_RESYNC>
+	{
+		static constexpr Direction DIRECTION = TO_SERVER;
+
+		static constexpr auto Fields() { return std::make_tuple(); }
+	};
+
+	template<>
+	struct Message<PACKET_SERVER_COMPRESSED>
+	{
+		static constexpr Direction DIRECTION = TO_CLIENT;
+
+		sf::Uint32 size;				// Size of the packet before it was compressed
+		std::vector<sf::Uint8> data;	// The whole packet, type included, compressed
+
+		static constexpr auto Fields() { return std::make_tuple(&Message::size, &Message::data); }
+	};
+}
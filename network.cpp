@@ -1,7 +1,144 @@
 #include "network.h"
+#include "messages.h"
+#include "compression.h"
+#include <algorithm>
+#include <cstring>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <linux/sockios.h>
+#endif
 
 namespace Network
 {
+	namespace
+	{
+		// Nothing we send comes anywhere near this; anything claiming to decompress to more is malformed
+		constexpr std::size_t MAX_DECOMPRESSED_BYTES = 1 << 20;
+
+		// The size at the start of a packet's frame
+		std::size_t ReadFrameSize(const sf::Uint8* header)
+		{
+			return (std::size_t(header[0]) << 24) | (std::size_t(header[1]) << 16) | (std::size_t(header[2]) << 8) | header[3];
+		}
+
+		// Frames a packet the way sf::TcpSocket does: the size, in network byte order, then the data
+		void AppendFrame(std::vector<sf::Uint8>& buffer, const sf::Packet& p)
+		{
+			sf::Uint32 size = sf::Uint32(p.getDataSize());
+			const sf::Uint8 header[4] = { sf::Uint8(size >> 24), sf::Uint8(size >> 16), sf::Uint8(size >> 8), sf::Uint8(size) };
+			const sf::Uint8* data = static_cast<const sf::Uint8*>(p.getData());
+
+			buffer.insert(buffer.end(), header, header + 4);
+			buffer.insert(buffer.end(), data, data + size);
+		}
+	}
+
+	bool CompressPacket(const sf::Packet& p, sf::Packet& compressed)
+	{
+		if (p.getDataSize() < COMPRESSION_THRESHOLD_BYTES)
+			return false;
+
+		Message<PACKET_SERVER_COMPRESSED> msg;
+		msg.size = sf::Uint32(p.getDataSize());
+		if (!Compression::Compress(static_cast<const sf::Uint8*>(p.getData()), p.getDataSize(), msg.data))
+			return false;
+
+		compressed = Encode(msg);
+		return true;
+	}
+
+	bool DecompressPacket(const Message<PACKET_SERVER_COMPRESSED>& msg, sf::Packet& p)
+	{
+		if (msg.size > MAX_DECOMPRESSED_BYTES)
+			return false;
+
+		thread_local std::vector<sf::Uint8> buffer;
+		buffer.clear();
+		if (!Compression::Decompress(msg.data.data(), msg.data.size(), msg.size, buffer) || buffer.empty())
+			return false;
+
+		// Compressed packets do not nest
+		if (buffer[0] == PACKET_SERVER_COMPRESSED)
+			return false;
+
+		p.clear();
+		p.append(buffer.data(), buffer.size());
+		return true;
+	}
+
+	bool DecompressPacket(const sf::Uint8* data, std::size_t size, sf::Packet& p)
+	{
+		Message<PACKET_SERVER_COMPRESSED> msg;
+		return Decode(data, size, msg) && DecompressPacket(msg, p);
+	}
+
+	Status ReceiveBuffer::Fill(sf::TcpSocket& socket)
+	{
+		std::size_t unread = mEnd - mBegin;
+
+		// Move what is left of a partial packet to the start, once there is no room left after it
+		if (mBegin > 0 && (unread == 0 || mBuffer.size() - mEnd < READ_BYTES))
+		{
+			std::memmove(mBuffer.data(), mBuffer.data() + mBegin, unread);
+			mBegin = 0;
+			mEnd = unread;
+		}
+
+		// Make room for the rest of the packet we are in the middle of
+		std::size_t required = mEnd + READ_BYTES;
+		if (unread >= HEADER_BYTES)
+		{
+			std::size_t size = ReadFrameSize(mBuffer.data() + mBegin);
+			if (size > MAX_PACKET_BYTES)
+				return Status::Error;
+
+			required = std::max(required, mBegin + HEADER_BYTES + size);
+		}
+
+		if (mBuffer.size() < required)
+			mBuffer.resize(required);
+
+		std::size_t received = 0;
+		Status ret = socket.receive(mBuffer.data() + mEnd, mBuffer.size() - mEnd, received);
+		mEnd += received;
+
+		return ret;
+	}
+
+	bool ReceiveBuffer::Next(const sf::Uint8*& data, std::size_t& size)
+	{
+		std::size_t unread = mEnd - mBegin;
+		if (unread < HEADER_BYTES)
+			return false;
+
+		const sf::Uint8* header = mBuffer.data() + mBegin;
+		std::size_t packetSize = ReadFrameSize(header);
+		if (unread - HEADER_BYTES < packetSize)
+			return false;
+
+		data = header + HEADER_BYTES;
+		size = packetSize;
+		mBegin += HEADER_BYTES + packetSize;
+		return true;
+	}
+
+	void ReceiveBuffer::SetUnread(const std::vector<sf::Uint8>& bytes)
+	{
+		mBuffer = bytes;
+		mBegin = 0;
+		mEnd = bytes.size();
+	}
+
+	std::size_t Socket::GetQueuedBytes() const
+	{
+#ifdef __linux__
+		int queued = 0;
+		if (ioctl(getHandle(), SIOCOUTQ, &queued) == 0 && queued > 0)
+			return queued;
+#endif
+		return 0;
+	}
+
 	bool Connection::Connect(const sf::IpAddress & ip, Port port)
 	{
 		if (socket.connect(ip, port) != Status::Done)
@@ -18,6 +155,12 @@ namespace Network
 
 	void Connection::Send(sf::Packet& p)
 	{
+		if (coalesce)
+		{
+			AppendFrame(outbox, p);
+			return;
+		}
+
 		Status ret;
 
 		do
@@ -33,52 +176,168 @@ namespace Network
 		}
 	}
 
-	bool Connection::Receive(sf::Packet & p)
+	void Connection::SendLatest(sf::Packet& p)
 	{
-		Status ret;
+		priority.OnUpdateQueued();
 
-		do
+		if (!coalesce)
 		{
-			ret = socket.receive(p);
-		} while (ret == Status::Partial);
+			Send(p);
+			priority.OnUpdateSent();
+			return;
+		}
 
-		switch (ret)
+		// Whatever update was still waiting is out of date now
+		if (!latestUpdate.empty())
 		{
-			case Status::Error:
-			case Status::Disconnected:
-				active = false;
-			case Status::NotReady:
-				return false;
+			rate.OnSnapshotDropped();
+			latestUpdate.clear();
+		}
+
+		AppendFrame(latestUpdate, p);
+	}
+
+	void Connection::Flush()
+	{
+		while (true)
+		{
+			// Once everything before it is out, the latest update joins the queue (and can no longer be replaced,
+			// since it may go out partly)
+			if (outboxSent == outbox.size())
+			{
+				outbox.clear();
+				outboxSent = 0;
+
+				if (latestUpdate.empty())
+					return;
+
+				outbox.swap(latestUpdate);
+				priority.OnUpdateSent();
+			}
+
+			std::size_t sent = 0;
+			Status ret = socket.send(outbox.data() + outboxSent, outbox.size() - outboxSent, sent);
+			outboxSent += sent;
+
+			switch (ret)
+			{
+				case Status::Done:
+					break;
+
+				// The OS send buffer is full; the rest waits rather than holding up the tick
+				case Status::Partial:
+				case Status::NotReady:
+					// Do not let what has been sent pile up at the front
+					if (outboxSent > outbox.size() / 2)
+					{
+						outbox.erase(outbox.begin(), outbox.begin() + outboxSent);
+						outboxSent = 0;
+					}
+					return;
+
+				default:
+					active = false;
+					return;
+			}
+		}
+	}
+
+	BackpressureEvent Connection::CheckBackpressure(const BackpressurePolicy& policy, time_point now)
+	{
+		std::size_t pending = GetPendingBytes();
+
+		if (pending > policy.dropPendingBytes)
+			return BACKPRESSURE_DROP;
+
+		if (pending <= policy.maxPendingBytes)
+		{
+			if (!isOverBudget)
+				return BACKPRESSURE_NONE;
+
+			isOverBudget = false;
+			isDemoted = false;
+			return BACKPRESSURE_RECOVERED;
+		}
+
+		if (!isOverBudget)
+		{
+			isOverBudget = true;
+			overBudgetSince = now;
+			return BACKPRESSURE_OVER_BUDGET;
+		}
+
+		if (now - overBudgetSince >= policy.dropAfter)
+			return BACKPRESSURE_DROP;
+
+		if (now - overBudgetSince >= policy.demoteAfter && !isDemoted)
+		{
+			isDemoted = true;
+			return BACKPRESSURE_DEMOTE;
+		}
+
+		return BACKPRESSURE_NONE;
+	}
+
+	bool Connection::Receive(const sf::Uint8*& data, std::size_t& size)
+	{
+		while (!inbox.Next(data, size))
+		{
+			switch (inbox.Fill(socket))
+			{
+				case Status::Done:
+					break;
+				case Status::Error:
+				case Status::Disconnected:
+					active = false;
+				default:
+					return false;
+			}
 		}
 
 		return true;
 	}
 
+	std::size_t Connection::SendCompressible(sf::Packet& p)
+	{
+		sf::Packet compressed;
+		if (Accepts(CAPABILITY_COMPRESSION_V2) && CompressPacket(p, compressed))
+		{
+			SendLatest(compressed);
+			return compressed.getDataSize();
+		}
+
+		SendLatest(p);
+		return p.getDataSize();
+	}
+
 	void Connection::SetBlocking(bool val)
 	{
 		socket.setBlocking(val);
 	}
 
-	sf::Packet InitPacket(PacketType type)
+	std::size_t SharedPacket::SendTo(Connection& connection, bool latest)
 	{
-		sf::Packet packet;
+		if (connection.Accepts(CAPABILITY_COMPRESSION_V2))
+		{
+			if (mCompression == NOT_TRIED)
+				mCompression = CompressPacket(mPacket, mCompressed) ? COMPRESSED : INCOMPRESSIBLE;
 
-		// SFML packets do not play nice with enums
-		// ... I won't need more than 255 packet types anyway
-		packet << sf::Uint8(type);
-		return packet;
-	}
-}
+			if (mCompression == COMPRESSED)
+			{
+				if (latest)
+					connection.SendLatest(mCompressed);
+				else
+					connection.Send(mCompressed);
 
-sf::Packet& operator<<(sf::Packet& p, const sf::Vector2f& v)
-{
-	p << v.x << v.y;
-	return p;
-}
+				return mCompressed.getDataSize();
+			}
+		}
 
-sf::Packet& operator>>(sf::Packet& p, sf::Vector2f& v)
-{
-	p >> v.x >> v.y;
-	return p;
-}
+		if (latest)
+			connection.SendLatest(mPacket);
+		else
+			connection.Send(mPacket);
 
+		return mPacket.getDataSize();
+	}
+}
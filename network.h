@@ -1,19 +1,26 @@
 #pragma once
 #include <SFML/Network.hpp>
 #include <memory>
+#include <vector>
 #include "common.h"
+#include "protocol.h"
+#include "clock_sync.h"
+#include "rate_controller.h"
+#include "priority_accumulator.h"
+#include "histogram.h"
 
 // Network.h: Contains code that is shared between Client and Server
 
-#define DEF_SERVER_RECV(type)		void Receive_##type(ConnectionPtr connection, sf::Packet& p)
+// Receive functions are specialisations of a Receive<PacketType> template, taking the decoded Message
+#define DEF_SERVER_RECV(type)		template<> void Receive<type>(ConnectionPtr connection, const Message<type>& p)
 #define DEF_SERVER_SEND(type)		void Send_##type(ConnectionPtr connection)
 
-#define DEF_CLIENT_RECV(type)		bool Receive_##type(sf::Packet& p)
+#define DEF_CLIENT_RECV(type)		template<> bool Receive<type>(const Message<type>& p)
 #define DEF_CLIENT_SEND(type)		void Send_##type()
 
 #define DEF_SEND_PARAM(type)		void Send_##type
 
-#define RECV(type)					Receive_##type
+#define RECV(type)					Receive<type>
 #define SEND(type)					Send_##type
 
 namespace Network
@@ -29,68 +36,196 @@ namespace Network
 		STATUS_SPECTATING,
 	};
 
+	// Packets smaller than this are not worth compressing
+	constexpr std::size_t COMPRESSION_THRESHOLD_BYTES = 128;
+
+	// Wraps 'p' in a PACKET_SERVER_COMPRESSED
+	// Returns false if 'p' is too small to be worth it, or does not compress
+	bool CompressPacket(const sf::Packet& p, sf::Packet& compressed);
+
+	// Unwraps the packet a PACKET_SERVER_COMPRESSED holds
+	bool DecompressPacket(const Message<PACKET_SERVER_COMPRESSED>& msg, sf::Packet& p);
+	bool DecompressPacket(const sf::Uint8* data, std::size_t size, sf::Packet& p);
+
+	// Receives packets into a buffer of its own and frames them in place, the way sf::TcpSocket frames them,
+	// so they are decoded straight from the bytes read off the socket
+	class ReceiveBuffer
+	{
+	public:
+		// Nothing we send comes anywhere near this; a peer claiming to send more is broken or malicious
+		static constexpr std::size_t MAX_PACKET_BYTES = 1 << 20;
+
+		// Reads whatever the socket has (blocks if the socket does)
+		// Returns Error if the peer sends a packet that is too big
+		Status Fill(sf::TcpSocket& socket);
+
+		// Points 'data' at the next whole packet, if there is one; valid until the next call to Fill
+		bool Next(const sf::Uint8*& data, std::size_t& size);
+
+		// Bytes received but not yet handed out
+		std::vector<sf::Uint8> GetUnread() const { return { mBuffer.begin() + mBegin, mBuffer.begin() + mEnd }; }
+		void SetUnread(const std::vector<sf::Uint8>& bytes);
+
+	private:
+		// Read at least this much at a time
+		static constexpr std::size_t READ_BYTES = 4096;
+		static constexpr std::size_t HEADER_BYTES = 4;
+
+		std::vector<sf::Uint8> mBuffer;
+		// Unread bytes are [mBegin, mEnd)
+		std::size_t mBegin = 0;
+		std::size_t mEnd = 0;
+	};
+
+	// What happens to a connection that cannot keep up with what is sent to it (see Connection::CheckBackpressure)
+	struct BackpressurePolicy
+	{
+		// Bytes that may wait to be sent before a connection is over budget
+		std::size_t maxPendingBytes = 64 * 1024;
+		// A connection with this much waiting is dropped straight away
+		std::size_t dropPendingBytes = 512 * 1024;
+
+		// How long a connection may stay over budget before it is sent updates at the slowest rate, and before it is dropped
+		ms demoteAfter{ 1000 };
+		ms dropAfter{ 5000 };
+	};
+
+	enum BackpressureEvent
+	{
+		BACKPRESSURE_NONE,
+		BACKPRESSURE_OVER_BUDGET,
+		BACKPRESSURE_DEMOTE,
+		BACKPRESSURE_DROP,
+		BACKPRESSURE_RECOVERED,
+	};
+
+	// Exposes what SFML keeps to itself about a socket
+	class Socket : public sf::TcpSocket
+	{
+	public:
+		// Number of bytes in the OS send buffer that have not been sent yet (0 where this is not supported)
+		std::size_t GetQueuedBytes() const;
+
+		// Takes over a connected socket handed over by another process (see handoff.h)
+		void Adopt(sf::SocketHandle handle) { create(handle); }
+		sf::SocketHandle GetHandle() const { return getHandle(); }
+	};
+
+	class Listener : public sf::TcpListener
+	{
+	public:
+		// Takes over a listening socket handed over by another process (see handoff.h)
+		void Adopt(sf::SocketHandle handle) { create(handle); }
+		sf::SocketHandle GetHandle() const { return getHandle(); }
+	};
+
 	struct Connection
 	{
 		bool Connect(const sf::IpAddress& ip, Port port);
 		void Disconnect();
 
+		// Sends 'p' straight away, or queues it until Flush if the connection coalesces
 		void Send(sf::Packet& p);
-		bool Receive(sf::Packet& p);
+		// Sends a state update, replacing one that has not started going out yet
+		void SendLatest(sf::Packet& p);
+
+		// Points 'data' at the next packet received (see ReceiveBuffer), which is valid until the next call
+		// Returns false once nothing more has arrived, or the connection is lost
+		bool Receive(const sf::Uint8*& data, std::size_t& size);
+
+		// Writes what is queued in one go, or as much of it as the socket takes; the rest waits for the next flush
+		void Flush();
+
+		// Bytes queued that the socket has not taken yet
+		std::size_t GetPendingBytes() const { return (outbox.size() - outboxSent) + latestUpdate.size(); }
+
+		// Keeps track of how long the connection has been over the policy's budget, and says what should be done about it
+		BackpressureEvent CheckBackpressure(const BackpressurePolicy& policy, time_point now);
+
+		template<PacketType TYPE>
+		void Send(const Message<TYPE>& msg)
+		{
+			sf::Packet p = Encode(msg);
+			Send(p);
+		}
+
+		// Sends a state update compressed, if the other end agreed to CAPABILITY_COMPRESSION_V2 and it pays off (see SendLatest)
+		// Returns the number of bytes sent
+		std::size_t SendCompressible(sf::Packet& p);
+
+		bool Accepts(Capability capability) const { return (capabilities.ValueOr(0) & capability) != 0; }
 
 		void SetBlocking(bool val);
 
 		// PlayerID
-		sf::Uint8 pid;
+		EntityID pid = INVALID_ENTITY;
 		bool active = false;
-		ms latency;
+		// The other end's clock, and the round trip time to it
+		ClockSync clock;
 		ConnectionStatus status = STATUS_NONE;
-		sf::TcpSocket socket;
+		Socket socket;
+
+		// A relay spectating on behalf of its own spectators (see relay.h)
+		bool relay = false;
+
+		// Capabilities agreed on when joining; absent for peers that asked for none
+		Trailing<sf::Uint8> capabilities;
+
+		// Queue packets until Flush, so everything sent to the connection during a tick goes out as
+		// one write (and, with Nagle's algorithm off, as few TCP segments as possible) rather than one per packet.
+		// Queued packets keep SFML's framing, so the other end receives them one by one as usual
+		bool coalesce = false;
+		std::vector<sf::Uint8> outbox;
+		std::size_t outboxSent = 0;
+		// The newest state update, which goes out once everything queued before it has
+		std::vector<sf::Uint8> latestUpdate;
+
+		// Backpressure
+		bool isOverBudget = false;
+		bool isDemoted = false;
+		time_point overBudgetSince;
+
+		ReceiveBuffer inbox;
+
+		// Server-side: When and how often this connection receives state updates, and what goes in them
+		RateController rate;
+		PriorityAccumulator priority;
+		time_point nextUpdatePoint;
+		// When the client joined as a player, on the server's clock; no snapshot before then holds its player
+		sf::Uint64 joinTime = 0;
+		// The client may be missing bullets, until a complete update reaches it
+		bool needsFullState = true;
+		// From when the client input a command to when we ran it (see CAPABILITY_INPUT_TIMES)
+		LatencyHistogram inputLatency;
 	};
 
 	using ConnectionPtr = std::shared_ptr<Connection>;
 
-	enum PacketType
+	// A packet sent to many connections, which is compressed once, the first time a connection that accepts it needs it
+	class SharedPacket
 	{
-		PACKET_CLIENT_JOIN,			// Request from the client to the server to join
-		PACKET_SERVER_WELCOME,		// Packet letting the client know they can join as a player
-		PACKET_SERVER_SPECTATOR,	// Packet letting the client know they can join as a spectator
-		PACKET_SERVER_FULL,			// Packet letting the client know it is full
-		PACKET_CLIENT_CMD,			// Packet containing a movement command from a client
-		PACKET_SERVER_PING,			// Ping request(and response; dual-purpose) from the server to the client
-		PACKET_CLIENT_PING,			// Ping response from the client
-		PACKET_SERVER_UPDATE,		// Packet from the server containing the current state of the game
-		PACKET_CLIENT_SHOOT,		// Request from the client to spawn a bullet
-		PACKET_SERVER_SHOOT,		// Packet from server informing clients that another client has shot
-		PACKET_END,
+	public:
+		SharedPacket() = default;
+		explicit SharedPacket(const sf::Packet& packet) : mPacket(packet) {}
+		// 'compressed' is the packet already compressed (e.g. as it arrived from upstream)
+		SharedPacket(const sf::Packet& packet, const sf::Packet& compressed) : mPacket(packet), mCompressed(compressed), mCompression(COMPRESSED) {}
+
+		bool IsEmpty() const { return mPacket.getDataSize() == 0; }
+
+		// latest: The packet is a state update (see Connection::SendLatest)
+		// Returns the number of bytes sent
+		std::size_t SendTo(Connection& connection, bool latest = false);
+
+	private:
+		enum CompressionState
+		{
+			NOT_TRIED,
+			COMPRESSED,
+			INCOMPRESSIBLE,
+		};
+
+		sf::Packet mPacket;
+		sf::Packet mCompressed;
+		CompressionState mCompression = NOT_TRIED;
 	};
-
-	sf::Packet InitPacket(PacketType type);
-}
-
-// Overloads
-sf::Packet& operator<<(sf::Packet& p, const sf::Vector2f& v);
-sf::Packet& operator >> (sf::Packet& p, sf::Vector2f& v);
-
-template<typename T>
-sf::Packet& operator<<(sf::Packet& p, const std::vector<T>& v)
-{
-	sf::Uint32 size = v.size();
-	p << size;
-	for (const auto& i : v)
-		p << i;
-
-	return p;
-}
-
-template<typename T>
-sf::Packet& operator >> (sf::Packet& p, std::vector<T>& v)
-{
-	sf::Uint32 size;
-	p >> size;
-	v.resize(size);
-
-	for (auto& i : v)
-		p >> i;
-
-	return p;
 }
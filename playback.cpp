@@ -0,0 +1,82 @@
+#include "playback.h"
+#include <algorithm>
+#include "common.h"
+#include "render.h"
+#include "recording.h"
+#include "debug.h"
+
+namespace Playback
+{
+	// How far a single key press seeks
+	constexpr int SEEK_STEP_MS = 5000;
+
+	bool PlayRecording(const std::string& path)
+	{
+		Recording::Reader reader;
+		if (!reader.Open(path))
+		{
+			debug << "PLAYBACK: Could not open " << path << std::endl;
+			return false;
+		}
+
+		debug << "PLAYBACK: Playing " << path << " (" << (reader.GetEndTime() - reader.GetStartTime()) / 1000000 << "s)" << std::endl;
+
+		sf::RenderWindow window(sf::VideoMode(VP_WIDTH, VP_HEIGHT), "Networking Paddles (playback)");
+		window.setFramerateLimit(60);
+
+		sf::Uint64 time = reader.GetStartTime();
+		bool isPaused = false;
+
+		auto lastFrame = the_clock::now();
+		while (window.isOpen())
+		{
+			sf::Event event;
+			while (window.pollEvent(event))
+			{
+				if (event.type == sf::Event::Closed)
+					window.close();
+				else if (event.type == sf::Event::KeyPressed)
+				{
+					switch (event.key.code)
+					{
+						case Key::Escape:
+							window.close();
+							break;
+						case Key::Space:
+							isPaused = !isPaused;
+							break;
+						case Key::Left:
+						case Key::Right:
+						{
+							sf::Int64 step = us(ms((event.key.code == Key::Left) ? -SEEK_STEP_MS : SEEK_STEP_MS)).count();
+							sf::Int64 target = std::max(sf::Int64(reader.GetStartTime()), std::min(sf::Int64(reader.GetEndTime()), sf::Int64(time) + step));
+							time = sf::Uint64(target);
+							reader.Seek(time);
+						}
+						break;
+						default:
+							break;
+					}
+				}
+			}
+
+			auto now = the_clock::now();
+			if (!isPaused)
+				time = std::min(reader.GetEndTime(), time + to_us(lastFrame, now).count());
+			lastFrame = now;
+
+			reader.Advance(time);
+
+			// Records are some time apart, so move bullets along to where they are now
+			const WorldSnapshot& snapshot = reader.GetSnapshot();
+			World world = snapshot.snapshot;
+			world.Update((time - snapshot.serverTime) / 1000);
+
+			window.clear();
+			RenderWorld(world, window);
+			window.display();
+		}
+
+		return true;
+	}
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include <string>
+
+// playback.h: Watching a recorded match (see recording.h) in a window
+//			   Left/Right: Seek back/forward, Space: Pause, Escape: Quit
+
+namespace Playback
+{
+	bool PlayRecording(const std::string& path);
+}
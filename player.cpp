@@ -1,13 +1,9 @@
 #include "player.h"
 #include "command.h"
 #include "common.h"
-#include "network.h"
 
 void Player::RunCommand(const Command& cmd, bool rec)
 {
-	constexpr sf::Uint32 KEY_A = 1 << Key::A;
-	constexpr sf::Uint32 KEY_D = 1 << Key::D;
-
 	mLastCommandID = cmd.id;
 
 	// Not pressing any buttons
@@ -18,21 +14,8 @@ void Player::RunCommand(const Command& cmd, bool rec)
 		if (rec)
 			int x = 0;
 
-		float distance = MOVE_SPEED * cmd.dt / 1000.f;
+		Scalar distance = DistanceIn(MOVE_SPEED, ms(cmd.dt));
 
 		mPosition.x += (cmd.direction == Command::LEFT) ? -distance : distance;
 	}
 }
-
-sf::Packet & operator<<(sf::Packet & p, const Player & player)
-{
-	p << player.mPID << player.mLastCommandID << player.mColour << player.mPosition;
-	return p;
-}
-
-sf::Packet& operator >> (sf::Packet& p, Player& player)
-{
-	p >> player.mPID >> player.mLastCommandID >> player.mColour >> player.mPosition;
-	return p;
-}
-
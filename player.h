@@ -1,44 +1,41 @@
 #pragma once
 #include <SFML/System.hpp>
 #include <cstdint>
-
-namespace sf
-{
-	class Packet;
-}
+#include <tuple>
+#include "fixed.h"
+#include "slot_map.h"
 
 struct Command;
 
 class Player
 {
 public:
-	friend sf::Packet& operator<<(sf::Packet& p, const Player& player);
-	friend sf::Packet& operator>>(sf::Packet& p, Player& player);
+	static constexpr Scalar MOVE_SPEED{ 400.f };
+	// Last command id of a player that has not sent any commands yet
+	static constexpr int NO_COMMAND = -1;
 
-	static constexpr float MOVE_SPEED = 400.f;
+	// Wire layout (protocol.h)
+	static constexpr auto Fields() { return std::make_tuple(&Player::mPID, &Player::mLastCommandID, &Player::mColour, &Player::mPosition); }
 
 	void RunCommand(const Command& cmd, bool rec);
 
-	void SetPID(sf::Uint8 pid) { mPID = pid; }
+	void SetID(EntityID pid) { mPID = pid; }
 	void SetColour(sf::Uint32 RGBA) { mColour = RGBA; }
 
-	void SetX(float x) { mPosition.x = x; }
-	void SetY(float y) { mPosition.y = y; }
-	void SetPosition(const sf::Vector2f& position) { mPosition = position; }
+	void SetX(Scalar x) { mPosition.x = x; }
+	void SetY(Scalar y) { mPosition.y = y; }
+	void SetPosition(const Vector& position) { mPosition = position; }
 	
 	void SetLastCommandID(int id) { mLastCommandID = id; }
 
-	sf::Uint8 GetID() const { return mPID; }
+	EntityID GetID() const { return mPID; }
 	sf::Uint32 GetColour() const { return mColour; }
 	int GetLastCommandID() const { return mLastCommandID; }
-	sf::Vector2f GetPosition() const { return mPosition; }
+	Vector GetPosition() const { return mPosition; }
 
 private:
-	sf::Uint8 mPID;
+	EntityID mPID;
 	sf::Uint32 mColour;
-	int mLastCommandID;
-	sf::Vector2f mPosition;
+	int mLastCommandID = NO_COMMAND;
+	Vector mPosition;
 };
-
-sf::Packet& operator<<(sf::Packet& p, const Player& player);
-sf::Packet& operator>>(sf::Packet& p, Player& player);
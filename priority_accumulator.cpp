@@ -0,0 +1,108 @@
+#include "priority_accumulator.h"
+#include "world.h"
+#include "protocol.h"
+#include <algorithm>
+#include <cmath>
+
+namespace Network
+{
+	namespace
+	{
+		// Bullets flying towards the receiver's paddle are this much more relevant
+		constexpr float INCOMING_WEIGHT = 2.f;
+	}
+
+	std::vector<std::size_t> PriorityAccumulator::SelectBullets(const World& world, EntityID viewer, ms dt, std::size_t budget)
+	{
+		const auto& bullets = world.GetBullets();
+		std::size_t capacity = budget / Wire::Codec<Bullet>::SIZE;
+
+		struct Candidate
+		{
+			std::size_t index;
+			float priority;
+		};
+
+		std::vector<Candidate> candidates;
+		candidates.reserve(bullets.size());
+
+		// Accumulate priority; bullets that no longer exist are forgotten
+		std::unordered_map<sf::Uint32, float> priorities;
+		priorities.reserve(bullets.size());
+		for (std::size_t i = 0; i < bullets.size(); ++i)
+		{
+			sf::Uint32 id = bullets[i].GetID();
+
+			auto it = mBulletPriority.find(id);
+			float priority = (it != mBulletPriority.end()) ? it->second : 0.f;
+			priority += GetBulletWeight(world, i, viewer) * dt.count();
+
+			priorities[id] = priority;
+			candidates.push_back({ i, priority });
+		}
+
+		mBulletPriority.swap(priorities);
+
+		// Most important first
+		if (candidates.size() > capacity)
+		{
+			std::nth_element(candidates.begin(), candidates.begin() + capacity, candidates.end(),
+				[](const Candidate& a, const Candidate& b) { return a.priority > b.priority; });
+			candidates.resize(capacity);
+		}
+
+		// What gets sent starts over once it goes out
+		std::vector<std::size_t> selected;
+		selected.reserve(candidates.size());
+		mSelected.clear();
+		for (const auto& candidate : candidates)
+		{
+			mSelected.push_back(bullets[candidate.index].GetID());
+			selected.push_back(candidate.index);
+		}
+
+		// Keep the world's order
+		std::sort(selected.begin(), selected.end());
+		return selected;
+	}
+
+	void PriorityAccumulator::OnUpdateQueued()
+	{
+		mQueued.swap(mSelected);
+		mSelected.clear();
+	}
+
+	void PriorityAccumulator::OnUpdateSent()
+	{
+		for (sf::Uint32 id : mQueued)
+		{
+			auto it = mBulletPriority.find(id);
+			if (it != mBulletPriority.end())
+				it->second = 0.f;
+		}
+
+		mQueued.clear();
+	}
+
+	float PriorityAccumulator::GetBulletWeight(const World& world, std::size_t index, EntityID viewer) const
+	{
+		const Player* player = world.GetPlayer(viewer);
+
+		// Spectators care about every bullet equally
+		if (!player)
+			return 1.f;
+
+		const Bullet& bullet = world.GetBullets()[index];
+
+		// Closer bullets matter more
+		sf::Vector2f offset = ToFloat(bullet.GetPosition() - player->GetPosition());
+		float distance = std::sqrt(offset.x * offset.x + offset.y * offset.y);
+		float weight = VP_HEIGHT / (VP_HEIGHT + distance);
+
+		// As do the ones that are coming at us
+		if (offset.y * float(bullet.GetDirection().y) < 0.f)
+			weight *= INCOMING_WEIGHT;
+
+		return weight;
+	}
+}
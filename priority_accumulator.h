@@ -0,0 +1,36 @@
+#pragma once
+#include <SFML/System.hpp>
+#include <unordered_map>
+#include <vector>
+#include "common.h"
+#include "slot_map.h"
+
+class World;
+
+// priority_accumulator.h: Decides which entities fit in a connection's next snapshot
+//						   Left out entities build up priority by relevance; the highest are sent and start over
+
+namespace Network
+{
+	class PriorityAccumulator
+	{
+	public:
+		// Returns the indices of the bullets to send, at most 'budget' bytes worth of them
+		// viewer: The receiving client's player id (INVALID_ENTITY for spectators)
+		// dt: Time since the previous snapshot was sent to this connection
+		std::vector<std::size_t> SelectBullets(const World& world, EntityID viewer, ms dt, std::size_t budget);
+
+		// The update holding the selection was queued, or started going out
+		void OnUpdateQueued();
+		void OnUpdateSent();
+
+	private:
+		float GetBulletWeight(const World& world, std::size_t index, EntityID viewer) const;
+
+		// Accumulated priority, by bullet id
+		std::unordered_map<sf::Uint32, float> mBulletPriority;
+		// Bullet ids selected for the update being built, and for the queued one
+		std::vector<sf::Uint32> mSelected;
+		std::vector<sf::Uint32> mQueued;
+	};
+}
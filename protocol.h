@@ -0,0 +1,446 @@
+#pragma once
+#include <SFML/Network.hpp>
+#include <array>
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "cow_vector.h"
+#include "fixed.h"
+#include "slot_map.h"
+
+// protocol.h: Compile-time packet schema
+//			   Every packet type is declared once as a Message<TYPE> (see messages.h) which lists its fields.
+//			   Exact-size encoders, decoders and the receive dispatch tables are generated from those declarations.
+//			   Wire format: [Uint8 type][fields...], integers and floats in network byte order
+//			   Timestamps are microseconds on the server's clock, unless a field says otherwise
+
+namespace Network
+{
+	enum PacketType
+	{
+		PACKET_CLIENT_JOIN,			// Request from the client to the server to join
+		PACKET_SERVER_WELCOME,		// Packet letting the client know they can join as a player
+		PACKET_SERVER_SPECTATOR,	// Packet letting the client know they can join as a spectator
+		PACKET_SERVER_FULL,			// Packet letting the client know it is full
+		PACKET_CLIENT_CMD,			// Packet containing a movement command from a client
+		PACKET_SERVER_PING,			// Ping request from the server to the client
+		PACKET_CLIENT_PING,			// Ping response from the client, which doubles as the client's clock sync request
+		PACKET_SERVER_CLOCK,		// The server's clock, in response to the client's clock sync request
+		PACKET_SERVER_UPDATE,		// Packet from the server containing the current state of the game
+		PACKET_CLIENT_SHOOT,		// Request from the client to spawn a bullet
+		PACKET_SERVER_SHOOT,		// Packet from server informing clients that another client has shot
+		PACKET_CLIENT_ACK,			// Acknowledgement of the newest state update the client has received
+		PACKET_SERVER_RATE,			// Packet letting the client know how often it will receive state updates
+		PACKET_SERVER_BACKLOG,		// Recent history of the game, sent to spectators when they join
+		PACKET_SERVER_COMPRESSED,	// Another packet, compressed (only sent to clients that agreed to CAPABILITY_COMPRESSION_V2)
+		PACKET_CLIENT_RESYNC,		// Request from the client for the server's bullets, since its own no longer match (see CAPABILITY_CHECKSUMS)
+		PACKET_END,
+	};
+
+	// Changes whenever the layout of a message or an entity does; a client that speaks another version is turned away when it joins
+	constexpr sf::Uint32 PROTOCOL_VERSION = 2;
+
+	// Optional features a client asks for when joining; the server answers with the ones it agreed to
+	enum Capability : sf::Uint8
+	{
+		CAPABILITY_COMPRESSION_V1 = 1 << 0,	// Retired: compression with the dictionary from before entity ids were widened; never agreed to
+		CAPABILITY_SPAWN_TOKENS = 1 << 1,	// Shots carry a token, which the server echoes back to the shooter with the bullet it spawned
+		CAPABILITY_CHECKSUMS = 1 << 2,		// State updates carry a checksum of the server's bullets, and leave the bullets out while the client's match
+		CAPABILITY_INPUT_TIMES = 1 << 3,	// Commands carry when they were input, so the server can measure how long they took to reach it
+		CAPABILITY_COMPRESSION_V2 = 1 << 4,	// Large packets may arrive as PACKET_SERVER_COMPRESSED (see compression.h)
+	};
+
+	// Which end of the connection receives a packet type
+	enum Direction
+	{
+		TO_SERVER,
+		TO_CLIENT,
+	};
+
+	// Contents of a packet type; specialised for every PacketType in messages.h
+	// A missing specialisation is a compile error when the dispatch tables are built
+	template<PacketType TYPE>
+	struct Message;
+
+	// Lets a receive function's primary template static_assert only when it is instantiated
+	template<PacketType TYPE>
+	constexpr bool NO_HANDLER = false;
+
+	// An optional field, which takes up no bytes when it is absent
+	// It must come last in Fields(), after any other Trailing fields
+	template<typename T>
+	struct Trailing
+	{
+		Trailing() = default;
+		Trailing(const T& v) : present(true), value(v) {}
+
+		T ValueOr(const T& fallback) const { return present ? value : fallback; }
+
+		bool present = false;
+		T value{};
+	};
+
+	namespace Wire
+	{
+		// Codec<T> describes how a type is laid out on the wire:
+		//	FIXED:	true if every value of T encodes to the same number of bytes
+		//	SIZE:	that number of bytes (only meaningful when FIXED)
+		//	Size:	number of bytes a specific value encodes to
+		//	Write:	encode at 'out' and advance it (the caller has reserved Size() bytes)
+		//	Read:	decode from 'in' and advance it. Fixed-size types trust the caller to have
+		//			checked SIZE bytes are available, variable-size types check their own length
+		template<typename T, typename = void>
+		struct Codec;
+
+		template<std::size_t N> struct UintOfSize;
+		template<> struct UintOfSize<1> { using type = sf::Uint8; };
+		template<> struct UintOfSize<2> { using type = sf::Uint16; };
+		template<> struct UintOfSize<4> { using type = sf::Uint32; };
+		template<> struct UintOfSize<8> { using type = sf::Uint64; };
+
+		// Integers and floats (big endian)
+		template<typename T>
+		struct Codec<T, std::enable_if_t<std::is_arithmetic<T>::value>>
+		{
+			using Bits = typename UintOfSize<sizeof(T)>::type;
+
+			static constexpr bool FIXED = true;
+			static constexpr std::size_t SIZE = sizeof(T);
+
+			static std::size_t Size(const T&) { return SIZE; }
+
+			static void Write(sf::Uint8*& out, const T& v)
+			{
+				Bits bits;
+				std::memcpy(&bits, &v, SIZE);
+
+				for (std::size_t i = SIZE; i-- > 0; )
+					*out++ = sf::Uint8(bits >> (8 * i));
+			}
+
+			static bool Read(const sf::Uint8*& in, const sf::Uint8*, T& v)
+			{
+				Bits bits = 0;
+				for (std::size_t i = 0; i < SIZE; ++i)
+					bits = Bits(bits << 8) | *in++;
+
+				std::memcpy(&v, &bits, SIZE);
+				return true;
+			}
+		};
+
+		// bool is sent as a whole byte, regardless of sizeof(bool)
+		template<>
+		struct Codec<bool>
+		{
+			static constexpr bool FIXED = true;
+			static constexpr std::size_t SIZE = 1;
+
+			static std::size_t Size(const bool&) { return SIZE; }
+			static void Write(sf::Uint8*& out, const bool& v) { *out++ = v ? 1 : 0; }
+			static bool Read(const sf::Uint8*& in, const sf::Uint8*, bool& v) { v = (*in++ != 0); return true; }
+		};
+
+		// Enums are sent as a single byte
+		template<typename T>
+		struct Codec<T, std::enable_if_t<std::is_enum<T>::value>>
+		{
+			static constexpr bool FIXED = true;
+			static constexpr std::size_t SIZE = 1;
+
+			static std::size_t Size(const T&) { return SIZE; }
+			static void Write(sf::Uint8*& out, const T& v) { *out++ = sf::Uint8(v); }
+			static bool Read(const sf::Uint8*& in, const sf::Uint8*, T& v) { v = T(*in++); return true; }
+		};
+
+		// Fixed-point numbers are sent as their raw 32-bit value
+		template<>
+		struct Codec<Fixed>
+		{
+			static constexpr bool FIXED = true;
+			static constexpr std::size_t SIZE = Codec<sf::Int32>::SIZE;
+
+			static std::size_t Size(const Fixed&) { return SIZE; }
+			static void Write(sf::Uint8*& out, const Fixed& v) { Codec<sf::Int32>::Write(out, v.GetRaw()); }
+
+			static bool Read(const sf::Uint8*& in, const sf::Uint8* end, Fixed& v)
+			{
+				sf::Int32 raw;
+				Codec<sf::Int32>::Read(in, end, raw);
+				v = Fixed::FromRaw(raw);
+				return true;
+			}
+		};
+
+		template<typename T>
+		struct Codec<sf::Vector2<T>>
+		{
+			static constexpr bool FIXED = true;
+			static constexpr std::size_t SIZE = 2 * Codec<T>::SIZE;
+
+			static std::size_t Size(const sf::Vector2<T>&) { return SIZE; }
+
+			static void Write(sf::Uint8*& out, const sf::Vector2<T>& v)
+			{
+				Codec<T>::Write(out, v.x);
+				Codec<T>::Write(out, v.y);
+			}
+
+			static bool Read(const sf::Uint8*& in, const sf::Uint8* end, sf::Vector2<T>& v)
+			{
+				Codec<T>::Read(in, end, v.x);
+				Codec<T>::Read(in, end, v.y);
+				return true;
+			}
+		};
+
+		// Reads a value, checking its length first if it is fixed-size
+		template<typename T>
+		bool ReadChecked(const sf::Uint8*& in, const sf::Uint8* end, T& v)
+		{
+			if (Codec<T>::FIXED && std::size_t(end - in) < Codec<T>::SIZE)
+				return false;
+
+			return Codec<T>::Read(in, end, v);
+		}
+
+		// Structs listing their members through a static constexpr Fields() function
+		template<typename M> struct MemberType;
+		template<typename C, typename T> struct MemberType<T C::*> { using type = T; };
+
+		template<typename Tuple> struct FieldsLayout;
+		template<typename... Ptrs>
+		struct FieldsLayout<std::tuple<Ptrs...>>
+		{
+			static constexpr bool FIXED = (true && ... && Codec<typename MemberType<Ptrs>::type>::FIXED);
+			static constexpr std::size_t SIZE = (std::size_t(0) + ... + Codec<typename MemberType<Ptrs>::type>::SIZE);
+		};
+
+		template<typename T>
+		struct Codec<T, std::void_t<decltype(T::Fields())>>
+		{
+			using Layout = FieldsLayout<decltype(T::Fields())>;
+
+			static constexpr bool FIXED = Layout::FIXED;
+			static constexpr std::size_t SIZE = Layout::SIZE;
+
+			static std::size_t Size(const T& v)
+			{
+				if constexpr (FIXED)
+					return SIZE;
+				else
+					return std::apply([&](auto... field) { return (std::size_t(0) + ... + FieldSize(v.*field)); }, T::Fields());
+			}
+
+			static void Write(sf::Uint8*& out, const T& v)
+			{
+				std::apply([&](auto... field) { (FieldWrite(out, v.*field), ...); }, T::Fields());
+			}
+
+			static bool Read(const sf::Uint8*& in, const sf::Uint8* end, T& v)
+			{
+				// A fixed-size struct has been checked as a whole, so its fields are read unchecked
+				if constexpr (FIXED)
+					return std::apply([&](auto... field) { return (true && ... && FieldRead(in, end, v.*field)); }, T::Fields());
+				else
+					return std::apply([&](auto... field) { return (true && ... && ReadChecked(in, end, v.*field)); }, T::Fields());
+			}
+
+		private:
+			template<typename F> static std::size_t FieldSize(const F& f) { return Codec<F>::Size(f); }
+			template<typename F> static void FieldWrite(sf::Uint8*& out, const F& f) { Codec<F>::Write(out, f); }
+			template<typename F> static bool FieldRead(const sf::Uint8*& in, const sf::Uint8* end, F& f) { return Codec<F>::Read(in, end, f); }
+		};
+
+		// Sequences: [Uint32 count][elements...]
+		// Sequences of bytes are copied as a block
+		template<typename Container, typename T>
+		struct SequenceCodec
+		{
+			static constexpr bool IS_BYTES = std::is_same<Container, std::vector<sf::Uint8>>::value;
+
+			static constexpr bool FIXED = false;
+			static constexpr std::size_t SIZE = 0;
+
+			static std::size_t Size(const Container& v)
+			{
+				if constexpr (Codec<T>::FIXED)
+					return Codec<sf::Uint32>::SIZE + v.size() * Codec<T>::SIZE;
+				else
+				{
+					std::size_t size = Codec<sf::Uint32>::SIZE;
+					for (const auto& i : v)
+						size += Codec<T>::Size(i);
+
+					return size;
+				}
+			}
+
+			static void Write(sf::Uint8*& out, const Container& v)
+			{
+				Codec<sf::Uint32>::Write(out, sf::Uint32(v.size()));
+
+				if constexpr (IS_BYTES)
+				{
+					if (!v.empty())
+						std::memcpy(out, v.data(), v.size());
+					out += v.size();
+				}
+				else
+				{
+					for (const auto& i : v)
+						Codec<T>::Write(out, i);
+				}
+			}
+
+			static bool Read(const sf::Uint8*& in, const sf::Uint8* end, Container& v)
+			{
+				sf::Uint32 count;
+				if (!ReadChecked(in, end, count))
+					return false;
+
+				// The length of every element is checked at once
+				if (Codec<T>::FIXED && std::size_t(end - in) / Codec<T>::SIZE < count)
+					return false;
+
+				if constexpr (IS_BYTES)
+				{
+					v.assign(in, in + count);
+					in += count;
+					return true;
+				}
+
+				// Only a count already checked against what is left is trusted with an allocation
+				v.clear();
+				if (Codec<T>::FIXED)
+					v.reserve(count);
+				for (sf::Uint32 n = 0; n < count; ++n)
+				{
+					T i;
+					if (Codec<T>::FIXED)
+						Codec<T>::Read(in, end, i);
+					else if (!Codec<T>::Read(in, end, i))
+						return false;
+
+					v.push_back(i);
+				}
+
+				return true;
+			}
+		};
+
+		template<typename T>
+		struct Codec<std::vector<T>> : SequenceCodec<std::vector<T>, T> {};
+
+		// Trailing fields are there if there is anything left to read
+		template<typename T>
+		struct Codec<Trailing<T>>
+		{
+			static constexpr bool FIXED = false;
+			static constexpr std::size_t SIZE = 0;
+
+			static std::size_t Size(const Trailing<T>& v) { return v.present ? Codec<T>::Size(v.value) : 0; }
+
+			static void Write(sf::Uint8*& out, const Trailing<T>& v)
+			{
+				if (v.present)
+					Codec<T>::Write(out, v.value);
+			}
+
+			static bool Read(const sf::Uint8*& in, const sf::Uint8* end, Trailing<T>& v)
+			{
+				v.present = (in != end);
+				return !v.present || ReadChecked(in, end, v.value);
+			}
+		};
+
+		template<typename T>
+		struct Codec<cow_vector<T>> : SequenceCodec<cow_vector<T>, T> {};
+
+		// Sent as a plain sequence; the slot table is rebuilt from the entities' ids
+		template<typename T>
+		struct Codec<slot_map<T>>
+		{
+			static constexpr bool FIXED = false;
+			static constexpr std::size_t SIZE = 0;
+
+			static std::size_t Size(const slot_map<T>& v) { return Codec<cow_vector<T>>::Size(v.elements()); }
+			static void Write(sf::Uint8*& out, const slot_map<T>& v) { Codec<cow_vector<T>>::Write(out, v.elements()); }
+
+			static bool Read(const sf::Uint8*& in, const sf::Uint8* end, slot_map<T>& v)
+			{
+				cow_vector<T> elements;
+				if (!Codec<cow_vector<T>>::Read(in, end, elements))
+					return false;
+
+				v.assign(elements);
+				return true;
+			}
+		};
+	}
+
+	// Number of bytes a message takes on the wire, including the type byte
+	template<PacketType TYPE>
+	std::size_t EncodedSize(const Message<TYPE>& msg)
+	{
+		return 1 + Wire::Codec<Message<TYPE>>::Size(msg);
+	}
+
+	// Appends the encoded message to a buffer
+	template<PacketType TYPE>
+	void EncodeTo(std::vector<sf::Uint8>& buffer, const Message<TYPE>& msg)
+	{
+		std::size_t offset = buffer.size();
+		buffer.resize(offset + EncodedSize(msg));
+
+		sf::Uint8* out = buffer.data() + offset;
+		*out++ = sf::Uint8(TYPE);
+		Wire::Codec<Message<TYPE>>::Write(out, msg);
+	}
+
+	template<PacketType TYPE>
+	sf::Packet Encode(const Message<TYPE>& msg)
+	{
+		thread_local std::vector<sf::Uint8> buffer;
+		buffer.clear();
+		EncodeTo(buffer, msg);
+
+		sf::Packet packet;
+		packet.append(buffer.data(), buffer.size());
+		return packet;
+	}
+
+	// Decodes a message's fields (the type byte has already been consumed)
+	// Fails if the payload is not exactly the size the schema says it should be
+	template<PacketType TYPE>
+	bool Decode(const sf::Uint8* data, std::size_t size, Message<TYPE>& msg)
+	{
+		const sf::Uint8* end = data + size;
+		return Wire::ReadChecked(data, end, msg) && data == end;
+	}
+
+	// Receive dispatch tables
+	// Entry<TYPE>::Call is used for every packet type travelling in direction DIR, nullptr for the rest
+	template<typename Fn, template<PacketType> class Entry, Direction DIR, PacketType TYPE>
+	constexpr Fn SelectEntry()
+	{
+		if constexpr (Message<TYPE>::DIRECTION == DIR)
+			return &Entry<TYPE>::Call;
+		else
+			return nullptr;
+	}
+
+	template<typename Fn, template<PacketType> class Entry, Direction DIR, std::size_t... I>
+	constexpr std::array<Fn, PACKET_END> MakeDispatchTable(std::index_sequence<I...>)
+	{
+		return {{ SelectEntry<Fn, Entry, DIR, PacketType(I)>()... }};
+	}
+
+	template<typename Fn, template<PacketType> class Entry, Direction DIR>
+	constexpr std::array<Fn, PACKET_END> MakeDispatchTable()
+	{
+		return MakeDispatchTable<Fn, Entry, DIR>(std::make_index_sequence<PACKET_END>());
+	}
+}
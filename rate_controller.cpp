@@ -0,0 +1,154 @@
+#include "rate_controller.h"
+#include <algorithm>
+#include <cstdlib>
+
+namespace Network
+{
+	namespace
+	{
+		// Extra round trip time (on top of latency) that counts as a link building a queue
+		constexpr int QUEUE_DELAY_LIMIT_MS = 80;
+		// Below this much extra round trip time the link is considered idle
+		constexpr int QUEUE_DELAY_TARGET_MS = 20;
+
+		// How much faster to send when the link is idle
+		constexpr int SHRINK_STEP_MS = 2;
+
+		// Snapshots that never get acknowledged (lost client, old client) are forgotten after this many
+		constexpr std::size_t MAX_IN_FLIGHT = 64;
+
+		// Do not bother the client about small changes
+		constexpr int NOTIFY_THRESHOLD_MS = 10;
+
+		// Smoothing factor for the moving averages
+		constexpr float SMOOTHING = 0.125f;
+
+		float Smooth(float average, float sample)
+		{
+			return (average > 0.f) ? average + (sample - average) * SMOOTHING : sample;
+		}
+	}
+
+	void RateController::SetBounds(ms minInterval, ms maxInterval)
+	{
+		mMinInterval = minInterval;
+		mMaxInterval = maxInterval;
+		mInterval = std::min(std::max(mInterval, mMinInterval), mMaxInterval);
+		mNotifiedInterval = mInterval;
+	}
+
+	void RateController::OnSnapshotSent(sf::Uint64 serverTime, std::size_t bytes, ms now)
+	{
+		mSnapshotBytes = Smooth(mSnapshotBytes, (float) bytes);
+		mLastSent = now;
+
+		// Unacknowledged for too long, so assume the worst
+		if (mInFlight.size() >= MAX_IN_FLIGHT)
+		{
+			mBytesInFlight -= mInFlight.front().bytes;
+			mInFlight.pop_front();
+			Grow();
+		}
+
+		// While nothing was in flight there was nothing to deliver, so that time does not count against the link
+		if (mInFlight.empty())
+			mDeliveredAt = now;
+
+		mInFlight.push_back({ serverTime, bytes, now, mDelivered, mDeliveredAt });
+		mBytesInFlight += bytes;
+	}
+
+	void RateController::OnSnapshotDropped()
+	{
+		if (mInFlight.empty())
+			return;
+
+		mBytesInFlight -= mInFlight.back().bytes;
+		mInFlight.pop_back();
+	}
+
+	bool RateController::OnSnapshotAcked(sf::Uint64 serverTime, ms now, ms latency, std::size_t queuedBytes)
+	{
+		// Acknowledging a snapshot acknowledges every one before it as well
+		std::size_t ackedBytes = 0;
+		InFlight acked{ 0, 0, ms(-1), 0, ms(0) };
+		while (!mInFlight.empty() && mInFlight.front().serverTime <= serverTime)
+		{
+			ackedBytes += mInFlight.front().bytes;
+			acked = mInFlight.front();
+			mInFlight.pop_front();
+		}
+
+		// Duplicate or stale ack
+		if (acked.sentAt.count() < 0)
+			return false;
+
+		mBytesInFlight -= ackedBytes;
+		mDelivered += ackedBytes;
+		mDeliveredAt = now;
+
+		// Delivery rate over the time the newest acknowledged snapshot was in flight: everything acknowledged
+		// in that time made it across the link in that time, however the acks happen to be spaced out
+		ms elapsed = now - acked.deliveredAt;
+		if (elapsed.count() > 0)
+			mBandwidth = Smooth(mBandwidth, (float) (mDelivered - acked.delivered) / elapsed.count());
+
+		ms rtt = now - acked.sentAt;
+		if (mMinRtt.count() < 0 || rtt < mMinRtt)
+			mMinRtt = rtt;
+
+		// The round trip the link manages when nothing is queued
+		ms baseRtt = (latency.count() > 0) ? std::min(latency, mMinRtt) : mMinRtt;
+		ms queueDelay = rtt - baseRtt;
+
+		// How long it will take to drain what is sitting in the OS send buffer
+		ms drainTime{ 0 };
+		if (mBandwidth > 0.f)
+			drainTime = ms(static_cast<long long>(queuedBytes / mBandwidth));
+
+		// Only back off once per round trip, the acks that follow still reflect the old rate
+		if (queueDelay.count() > QUEUE_DELAY_LIMIT_MS || drainTime.count() > QUEUE_DELAY_LIMIT_MS)
+		{
+			if (now - mLastGrow >= rtt)
+			{
+				Grow();
+				mLastGrow = now;
+			}
+		}
+		else if (queueDelay.count() < QUEUE_DELAY_TARGET_MS && drainTime.count() < QUEUE_DELAY_TARGET_MS)
+			Shrink();
+
+		if (std::abs((mInterval - mNotifiedInterval).count()) < NOTIFY_THRESHOLD_MS)
+			return false;
+
+		mNotifiedInterval = mInterval;
+		return true;
+	}
+
+	bool RateController::Demote()
+	{
+		mInterval = mMaxInterval;
+
+		if (mInterval == mNotifiedInterval)
+			return false;
+
+		mNotifiedInterval = mInterval;
+		return true;
+	}
+
+	void RateController::Grow()
+	{
+		// Back off multiplicatively, and never send faster than a snapshot can be delivered
+		ms interval = mInterval * 3 / 2;
+
+		if (mBandwidth > 0.f)
+			interval = std::max(interval, ms(static_cast<long long>(mSnapshotBytes / mBandwidth)));
+
+		mInterval = std::min(std::max(interval, mMinInterval), mMaxInterval);
+	}
+
+	void RateController::Shrink()
+	{
+		mInterval = std::max(mInterval - ms(SHRINK_STEP_MS), mMinInterval);
+	}
+}
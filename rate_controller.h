@@ -0,0 +1,75 @@
+#pragma once
+#include <SFML/System.hpp>
+#include <deque>
+#include "common.h"
+
+// rate_controller.h: Chooses how often a connection receives snapshots
+//					  Acks slower than the connection's latency mean a queue is building, so the interval grows;
+//					  prompt acks shrink it again
+
+namespace Network
+{
+	class RateController
+	{
+	public:
+		static constexpr int DEFAULT_INTERVAL_MS = 50;
+
+		// The client should be told about the new interval afterwards
+		void SetBounds(ms minInterval, ms maxInterval);
+
+		void OnSnapshotSent(sf::Uint64 serverTime, std::size_t bytes, ms now);
+		// The snapshot sent last was replaced before it went out
+		void OnSnapshotDropped();
+
+		// latency: The connection's latency measured by pinging
+		// queuedBytes: Bytes waiting in the OS send buffer
+		// Returns true if the interval has changed enough that the client should be told about it
+		bool OnSnapshotAcked(sf::Uint64 serverTime, ms now, ms latency, std::size_t queuedBytes);
+
+		// Drops to the slowest rate, for a connection that is not keeping up at all; acks speed it up again as usual
+		// Returns true if the client should be told about the new interval
+		bool Demote();
+
+		ms GetInterval() const { return mInterval; }
+		// Time since the previous snapshot was sent (the interval, before the first one)
+		ms GetTimeSinceSent(ms now) const { return (mLastSent.count() >= 0) ? now - mLastSent : mInterval; }
+		std::size_t GetBytesInFlight() const { return mBytesInFlight; }
+		// Estimated delivery rate, in bytes per millisecond
+		float GetBandwidth() const { return mBandwidth; }
+
+	private:
+		// Snapshots that are sent, but not yet acknowledged
+		struct InFlight
+		{
+			sf::Uint64 serverTime;
+			std::size_t bytes;
+			ms sentAt;
+			// What had been delivered when it was sent, and when the last of that was
+			std::size_t delivered;
+			ms deliveredAt;
+		};
+
+		void Grow();
+		void Shrink();
+
+		std::deque<InFlight> mInFlight;
+		std::size_t mBytesInFlight = 0;
+		// Bytes acknowledged so far, and when the last of them were
+		std::size_t mDelivered = 0;
+		ms mDeliveredAt{ 0 };
+
+		// Smoothed estimates
+		float mBandwidth = 0.f;
+		float mSnapshotBytes = 0.f;
+		ms mMinRtt{ -1 };
+		ms mLastSent{ -1 };
+		ms mLastGrow{ 0 };
+
+		ms mMinInterval{ 33 };
+		ms mMaxInterval{ 250 };
+		ms mInterval{ DEFAULT_INTERVAL_MS };
+
+		// The last interval the client was told about
+		ms mNotifiedInterval{ DEFAULT_INTERVAL_MS };
+	};
+}
@@ -0,0 +1,470 @@
+#include "recording.h"
+#include <algorithm>
+#include <cstring>
+#include <unordered_set>
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "debug.h"
+
+namespace Recording
+{
+	using namespace Network::Wire;
+
+	namespace
+	{
+		constexpr char HEADER_MAGIC[] = { 'N', 'P', 'R', 'E', 'C' };
+		constexpr char FOOTER_MAGIC[] = { 'N', 'P', 'I', 'D', 'X' };
+		constexpr sf::Uint32 VERSION = 2;
+
+		constexpr std::size_t HEADER_SIZE = sizeof(HEADER_MAGIC) + Codec<sf::Uint32>::SIZE;
+		constexpr std::size_t RECORD_HEADER_SIZE = Codec<sf::Uint8>::SIZE + Codec<sf::Uint32>::SIZE + Codec<sf::Uint64>::SIZE;
+		constexpr std::size_t FOOTER_SIZE = Codec<sf::Uint64>::SIZE + Codec<sf::Uint32>::SIZE + Codec<sf::Uint64>::SIZE + sizeof(FOOTER_MAGIC);
+
+		// How far apart keyframes are; seeking decodes at most this much of the recording
+		constexpr int KEYFRAME_INTERVAL_MS = 2000;
+
+		template<typename T>
+		bool DecodePayload(const sf::Uint8* payload, std::size_t size, T& value)
+		{
+			const sf::Uint8* end = payload + size;
+			return ReadChecked(payload, end, value) && payload == end;
+		}
+	}
+
+	// RECORDER ////////////////////////////////////////
+
+	bool Recorder::Start(const std::string& path)
+	{
+		Stop();
+
+		mFile = std::fopen(path.c_str(), "wb");
+		if (!mFile)
+		{
+			debug << "RECORDING: Could not open " << path << " for writing" << std::endl;
+			return false;
+		}
+
+		sf::Uint8 header[HEADER_SIZE];
+		std::memcpy(header, HEADER_MAGIC, sizeof(HEADER_MAGIC));
+		sf::Uint8* out = header + sizeof(HEADER_MAGIC);
+		Codec<sf::Uint32>::Write(out, VERSION);
+		std::fwrite(header, 1, HEADER_SIZE, mFile);
+
+		mOffset = HEADER_SIZE;
+		mIndex.clear();
+		mPreviousBullets.clear();
+		mLastKeyframeTime = 0;
+		mLastRecordTime = 0;
+
+		mIsRunning = true;
+		mThread = std::thread(&Recorder::WriterTask, this);
+
+		debug << "RECORDING: Recording to " << path << std::endl;
+		return true;
+	}
+
+	void Recorder::Stop()
+	{
+		if (!mIsRunning)
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mIsRunning = false;
+		}
+
+		mCondition.notify_one();
+		mThread.join();
+
+		// Index and footer
+		mBuffer.assign(mIndex.size() * Codec<IndexEntry>::SIZE + FOOTER_SIZE, 0);
+		sf::Uint8* out = mBuffer.data();
+		for (const auto& entry : mIndex)
+			Codec<IndexEntry>::Write(out, entry);
+
+		Codec<sf::Uint64>::Write(out, mOffset);
+		Codec<sf::Uint32>::Write(out, sf::Uint32(mIndex.size()));
+		Codec<sf::Uint64>::Write(out, mLastRecordTime);
+		std::memcpy(out, FOOTER_MAGIC, sizeof(FOOTER_MAGIC));
+
+		std::fwrite(mBuffer.data(), 1, mBuffer.size(), mFile);
+		std::fclose(mFile);
+		mFile = nullptr;
+
+		debug << "RECORDING: Stopped recording" << std::endl;
+	}
+
+	void Recorder::RecordSnapshot(const WorldSnapshot& snapshot)
+	{
+		if (!mIsRunning)
+			return;
+
+		// Copied out of the world's shared storage, which only the server's thread may touch
+		Pending pending{ RECORD_DELTA, snapshot.serverTime, {}, {} };
+		const World& world = snapshot.snapshot;
+		pending.world.players.reserve(world.GetPlayers().size());
+		for (const auto& player : world.GetPlayers())
+			pending.world.players.push_back(player);
+		pending.world.bullets.reserve(world.GetBullets().size());
+		for (const auto& bullet : world.GetBullets())
+			pending.world.bullets.push_back(bullet);
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mQueue.push_back(std::move(pending));
+		}
+
+		mCondition.notify_one();
+	}
+
+	void Recorder::RecordShot(const Bullet& bullet, sf::Uint64 serverTime)
+	{
+		if (!mIsRunning)
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mQueue.push_back({ RECORD_SHOT, serverTime, {}, { bullet, serverTime } });
+		}
+
+		mCondition.notify_one();
+	}
+
+	void Recorder::WriterTask()
+	{
+		std::vector<Pending> pending;
+
+		while (true)
+		{
+			bool isRunning;
+			{
+				std::unique_lock<std::mutex> lock(mMutex);
+				mCondition.wait(lock, [this] { return !mQueue.empty() || !mIsRunning; });
+
+				pending.swap(mQueue);
+				isRunning = mIsRunning;
+			}
+
+			for (const auto& item : pending)
+			{
+				if (item.kind == RECORD_SHOT)
+					WriteShot(item.shot);
+				else
+					WriteSnapshot(item.serverTime, item.world);
+			}
+
+			pending.clear();
+
+			if (!isRunning)
+				break;
+		}
+
+		std::fflush(mFile);
+	}
+
+	void Recorder::WriteSnapshot(sf::Uint64 serverTime, const Keyframe& world)
+	{
+		if (mIndex.empty() || serverTime - mLastKeyframeTime >= (sf::Uint64) us(ms(KEYFRAME_INTERVAL_MS)).count())
+		{
+			mIndex.push_back({ serverTime, mOffset });
+			mLastKeyframeTime = serverTime;
+
+			WriteRecord(RECORD_KEYFRAME, serverTime, world);
+		}
+		else
+		{
+			Delta delta;
+			for (const auto& player : world.players)
+				delta.players.push_back(player);
+
+			std::unordered_set<sf::Uint32> current;
+			for (const auto& bullet : world.bullets)
+				current.insert(bullet.GetID());
+
+			std::unordered_set<sf::Uint32> previous(mPreviousBullets.begin(), mPreviousBullets.end());
+			for (sf::Uint32 id : mPreviousBullets)
+			{
+				if (!current.count(id))
+					delta.removed.push_back(id);
+			}
+
+			for (const auto& bullet : world.bullets)
+			{
+				if (!previous.count(bullet.GetID()))
+					delta.added.push_back(bullet);
+			}
+
+			WriteRecord(RECORD_DELTA, serverTime, delta);
+		}
+
+		mPreviousBullets.clear();
+		for (const auto& bullet : world.bullets)
+			mPreviousBullets.push_back(bullet.GetID());
+	}
+
+	void Recorder::WriteShot(const Shot& shot)
+	{
+		WriteRecord(RECORD_SHOT, shot.serverTime, shot.bullet);
+	}
+
+	template<typename T>
+	void Recorder::WriteRecord(RecordKind kind, sf::Uint64 serverTime, const T& payload)
+	{
+		std::size_t size = Codec<T>::Size(payload);
+
+		mBuffer.resize(RECORD_HEADER_SIZE + size);
+		sf::Uint8* out = mBuffer.data();
+		Codec<sf::Uint8>::Write(out, sf::Uint8(kind));
+		Codec<sf::Uint32>::Write(out, sf::Uint32(size));
+		Codec<sf::Uint64>::Write(out, serverTime);
+		Codec<T>::Write(out, payload);
+
+		std::fwrite(mBuffer.data(), 1, mBuffer.size(), mFile);
+		mOffset += mBuffer.size();
+		mLastRecordTime = std::max(mLastRecordTime, serverTime);
+	}
+
+	// READER //////////////////////////////////////////
+
+	bool Reader::Open(const std::string& path)
+	{
+		Close();
+
+#ifdef _WIN32
+		std::ifstream file(path, std::ios::binary);
+		if (!file)
+			return false;
+
+		mFileData.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		mData = mFileData.data();
+		mSize = mFileData.size();
+#else
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+
+		struct stat info;
+		if (fstat(fd, &info) != 0 || info.st_size == 0)
+		{
+			close(fd);
+			return false;
+		}
+
+		// Pages are only read in as playback touches them, so opening is instant regardless of length
+		void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+
+		if (data == MAP_FAILED)
+			return false;
+
+		mData = static_cast<const sf::Uint8*>(data);
+		mSize = info.st_size;
+#endif
+
+		if (mSize < HEADER_SIZE || std::memcmp(mData, HEADER_MAGIC, sizeof(HEADER_MAGIC)) != 0)
+		{
+			debug << "RECORDING: " << path << " is not a recording" << std::endl;
+			Close();
+			return false;
+		}
+
+		const sf::Uint8* in = mData + sizeof(HEADER_MAGIC);
+		sf::Uint32 version;
+		Codec<sf::Uint32>::Read(in, nullptr, version);
+		if (version != VERSION)
+		{
+			debug << "RECORDING: " << path << " was recorded by an incompatible server (version " << version << ')' << std::endl;
+			Close();
+			return false;
+		}
+
+		const sf::Uint8* footer = (mSize >= HEADER_SIZE + FOOTER_SIZE) ? mData + mSize - FOOTER_SIZE : nullptr;
+		if (footer && std::memcmp(footer + FOOTER_SIZE - sizeof(FOOTER_MAGIC), FOOTER_MAGIC, sizeof(FOOTER_MAGIC)) == 0)
+		{
+			sf::Uint64 indexOffset;
+			sf::Uint32 indexCount;
+			Codec<sf::Uint64>::Read(footer, nullptr, indexOffset);
+			Codec<sf::Uint32>::Read(footer, nullptr, indexCount);
+			Codec<sf::Uint64>::Read(footer, nullptr, mEndTime);
+
+			mRecordsEnd = indexOffset;
+			mIndexCount = indexCount;
+
+			if (mRecordsEnd > mSize - FOOTER_SIZE || mIndexCount * Codec<IndexEntry>::SIZE != mSize - FOOTER_SIZE - mRecordsEnd)
+			{
+				Close();
+				return false;
+			}
+		}
+		// The recording was cut short (the server did not shut down cleanly), so find the keyframes ourselves
+		else if (!BuildIndex())
+		{
+			Close();
+			return false;
+		}
+
+		if (mIndexCount == 0)
+		{
+			Close();
+			return false;
+		}
+
+		mStartTime = ReadIndexEntry(0).serverTime;
+		Seek(mStartTime);
+		return true;
+	}
+
+	void Reader::Close()
+	{
+#ifdef _WIN32
+		mFileData.clear();
+#else
+		if (mData)
+			munmap(const_cast<sf::Uint8*>(mData), mSize);
+#endif
+
+		mData = nullptr;
+		mSize = 0;
+		mRecordsEnd = 0;
+		mIndexCount = 0;
+		mScannedIndex.clear();
+		mCursor = 0;
+		mState = WorldSnapshot();
+	}
+
+	void Reader::Seek(sf::Uint64 time)
+	{
+		// Last keyframe at or before 'time'
+		std::size_t low = 0, high = mIndexCount;
+		while (low < high)
+		{
+			std::size_t mid = (low + high) / 2;
+			if (ReadIndexEntry(mid).serverTime <= time)
+				low = mid + 1;
+			else
+				high = mid;
+		}
+
+		mCursor = ReadIndexEntry(low ? low - 1 : 0).offset;
+		mState = WorldSnapshot();
+
+		Advance(time);
+	}
+
+	bool Reader::Advance(sf::Uint64 time, std::vector<Shot>* shots)
+	{
+		Record record;
+		while (mCursor < mRecordsEnd && ReadRecord(mCursor, record) && record.serverTime <= time)
+		{
+			mCursor += RECORD_HEADER_SIZE + record.size;
+
+			switch (record.kind)
+			{
+				case RECORD_KEYFRAME:
+				{
+					World world;
+					if (DecodePayload(record.payload, record.size, world))
+					{
+						mState.snapshot = world;
+						mState.serverTime = record.serverTime;
+					}
+				}
+				break;
+
+				case RECORD_DELTA:
+				{
+					Delta delta;
+					if (!DecodePayload(record.payload, record.size, delta))
+						break;
+
+					// Surviving bullets carry on as they were (stepped in whole milliseconds, like the server does)
+					mState.snapshot.Update(record.serverTime / 1000 - mState.serverTime / 1000);
+
+					mState.snapshot.SetPlayers(delta.players);
+					for (sf::Uint32 id : delta.removed)
+						mState.snapshot.RemoveBullet(id);
+					for (const auto& bullet : delta.added)
+						mState.snapshot.AddBullet(bullet);
+
+					mState.serverTime = record.serverTime;
+				}
+				break;
+
+				case RECORD_SHOT:
+				{
+					Shot shot;
+					if (shots && DecodePayload(record.payload, record.size, shot.bullet))
+					{
+						shot.serverTime = record.serverTime;
+						shots->push_back(shot);
+					}
+				}
+				break;
+			}
+		}
+
+		return mCursor < mRecordsEnd;
+	}
+
+	bool Reader::ReadRecord(std::size_t offset, Record& record) const
+	{
+		if (mRecordsEnd - offset < RECORD_HEADER_SIZE)
+			return false;
+
+		const sf::Uint8* in = mData + offset;
+		sf::Uint8 kind;
+		sf::Uint32 size;
+		Codec<sf::Uint8>::Read(in, nullptr, kind);
+		Codec<sf::Uint32>::Read(in, nullptr, size);
+		Codec<sf::Uint64>::Read(in, nullptr, record.serverTime);
+
+		if (mRecordsEnd - offset - RECORD_HEADER_SIZE < size)
+			return false;
+
+		record.kind = RecordKind(kind);
+		record.payload = in;
+		record.size = size;
+		return true;
+	}
+
+	IndexEntry Reader::ReadIndexEntry(std::size_t i) const
+	{
+		if (!mScannedIndex.empty())
+			return mScannedIndex[i];
+
+		// Decoded straight from the mapped file
+		IndexEntry entry;
+		const sf::Uint8* in = mData + mRecordsEnd + i * Codec<IndexEntry>::SIZE;
+		Codec<IndexEntry>::Read(in, nullptr, entry);
+		return entry;
+	}
+
+	bool Reader::BuildIndex()
+	{
+		mRecordsEnd = mSize;
+
+		Record record;
+		std::size_t offset = HEADER_SIZE;
+		while (ReadRecord(offset, record))
+		{
+			if (record.kind == RECORD_KEYFRAME)
+				mScannedIndex.push_back({ record.serverTime, offset });
+
+			mEndTime = std::max(mEndTime, record.serverTime);
+			offset += RECORD_HEADER_SIZE + record.size;
+		}
+
+		// Ignore a record that was only partially written
+		mRecordsEnd = offset;
+		mIndexCount = mScannedIndex.size();
+
+		debug << "RECORDING: Recording has no index, found " << mIndexCount << " keyframes by scanning it" << std::endl;
+		return mIndexCount > 0;
+	}
+}
@@ -0,0 +1,161 @@
+#pragma once
+#include <SFML/System.hpp>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "messages.h"
+
+// recording.h: Recording and playing back matches
+//				Records are keyframes, deltas and shots; the keyframe index at the end is for seeking
+//
+//				File layout:
+//				[header]		"NPREC" magic, version
+//				[records...]	[Uint8 kind][Uint32 payload size][Uint64 serverTime][payload]
+//				[index]			[Uint64 serverTime][Uint64 offset] per keyframe
+//				[footer]		[Uint64 index offset][Uint32 index entries][Uint64 end time]["NPIDX" magic]
+
+namespace Recording
+{
+	using Network::Message;
+	using Network::PACKET_SERVER_SHOOT;
+
+	using Shot = Message<PACKET_SERVER_SHOOT>;
+
+	enum RecordKind
+	{
+		RECORD_KEYFRAME,
+		RECORD_DELTA,
+		RECORD_SHOT,
+	};
+
+	// What changed between two records; only bullets that appeared or disappeared are stored
+	struct Delta
+	{
+		cow_vector<Player> players;
+		std::vector<Bullet> added;
+		std::vector<sf::Uint32> removed;
+
+		static constexpr auto Fields() { return std::make_tuple(&Delta::players, &Delta::added, &Delta::removed); }
+	};
+
+	// A keyframe's payload, laid out exactly like a World
+	struct Keyframe
+	{
+		std::vector<Player> players;
+		std::vector<Bullet> bullets;
+
+		static constexpr auto Fields() { return std::make_tuple(&Keyframe::players, &Keyframe::bullets); }
+	};
+
+	struct IndexEntry
+	{
+		sf::Uint64 serverTime;
+		sf::Uint64 offset;
+
+		static constexpr auto Fields() { return std::make_tuple(&IndexEntry::serverTime, &IndexEntry::offset); }
+	};
+
+	// Writes a recording on a thread of its own; the world is deep copied for it, as cow_vector is not thread-safe
+	class Recorder
+	{
+	public:
+		~Recorder() { Stop(); }
+
+		bool Start(const std::string& path);
+		// Writes the index and closes the file
+		void Stop();
+
+		bool IsRecording() const { return mIsRunning; }
+
+		void RecordSnapshot(const WorldSnapshot& snapshot);
+		void RecordShot(const Bullet& bullet, sf::Uint64 serverTime);
+
+	private:
+		struct Pending
+		{
+			RecordKind kind;
+			sf::Uint64 serverTime;
+			Keyframe world;
+			Shot shot;
+		};
+
+		void WriterTask();
+		void WriteSnapshot(sf::Uint64 serverTime, const Keyframe& world);
+		void WriteShot(const Shot& shot);
+
+		template<typename T>
+		void WriteRecord(RecordKind kind, sf::Uint64 serverTime, const T& payload);
+
+		std::thread mThread;
+		std::mutex mMutex;
+		std::condition_variable mCondition;
+		std::vector<Pending> mQueue;
+		bool mIsRunning = false;
+
+		// Only touched by the writer thread
+		std::FILE* mFile = nullptr;
+		sf::Uint64 mOffset = 0;
+		std::vector<sf::Uint8> mBuffer;
+		std::vector<IndexEntry> mIndex;
+		// Bullets in the last snapshot written
+		std::vector<sf::Uint32> mPreviousBullets;
+		sf::Uint64 mLastKeyframeTime = 0;
+		sf::Uint64 mLastRecordTime = 0;
+	};
+
+	// Plays a recording back from a memory-mapped file
+	class Reader
+	{
+	public:
+		~Reader() { Close(); }
+
+		bool Open(const std::string& path);
+		void Close();
+
+		sf::Uint64 GetStartTime() const { return mStartTime; }
+		sf::Uint64 GetEndTime() const { return mEndTime; }
+
+		// Jumps to the state of the game at 'time'
+		void Seek(sf::Uint64 time);
+
+		// Plays forward to 'time', appending the shots fired along the way to 'shots'
+		// Returns false once the end of the recording is reached
+		bool Advance(sf::Uint64 time, std::vector<Shot>* shots = nullptr);
+
+		const WorldSnapshot& GetSnapshot() const { return mState; }
+
+	private:
+		struct Record
+		{
+			RecordKind kind;
+			sf::Uint64 serverTime;
+			const sf::Uint8* payload;
+			std::size_t size;
+		};
+
+		bool ReadRecord(std::size_t offset, Record& record) const;
+		IndexEntry ReadIndexEntry(std::size_t i) const;
+		bool BuildIndex();
+
+		const sf::Uint8* mData = nullptr;
+		std::size_t mSize = 0;
+#ifdef _WIN32
+		std::vector<sf::Uint8> mFileData;
+#endif
+
+		// Where the records end, and the index starts
+		std::size_t mRecordsEnd = 0;
+		std::size_t mIndexCount = 0;
+		// Index built by scanning, for recordings that were never closed properly
+		std::vector<IndexEntry> mScannedIndex;
+
+		sf::Uint64 mStartTime = 0;
+		sf::Uint64 mEndTime = 0;
+
+		std::size_t mCursor = 0;
+		WorldSnapshot mState;
+	};
+}
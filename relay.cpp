@@ -0,0 +1,487 @@
+#include "relay.h"
+#include <algorithm>
+#include "messages.h"
+#include "backlog.h"
+#include "recording.h"
+#include "debug.h"
+
+namespace Network
+{
+	namespace Relay
+	{
+		// Global Variables //////
+
+		// Downstream spectators are cheap, but not free
+		constexpr int MAX_SPECTATORS = 256;
+
+		// Time to wait at socket selector
+		constexpr int WAIT_TIME_MS = 10;
+
+		constexpr int PING_INTERVAL_MS = 250;
+
+		// Networking
+		Connection gUpstream;
+		sf::TcpListener gListener;
+		sf::SocketSelector gSelector;
+		std::vector<ConnectionPtr> gSpectators;
+
+		BackpressurePolicy gBackpressurePolicy;
+
+		// Recent history and the newest rate, for spectators that join in between updates
+		constexpr int BACKLOG_MS = 1600;
+		SnapshotBacklog gBacklog{ ms(BACKLOG_MS) };
+		sf::Packet gLastRate;
+
+		// Recordings are written with this long between snapshots (see server.cpp)
+		constexpr int PLAYBACK_UPDATE_INTERVAL_MS = 50;
+
+		// Timestamps we pass on are on the game server's clock (or the recording's); spectators
+		// synchronise with our estimate of it, which we keep synchronised with upstream
+		time_point gStartTime;
+		ClockSync gStreamClock;
+		time_point gNextPingPoint;
+
+		sf::Uint64 GetClockTime()
+		{
+			return to_us(gStartTime, the_clock::now()).count();
+		}
+
+		sf::Uint64 GetStreamTime()
+		{
+			return gStreamClock.ToRemote(GetClockTime());
+		}
+
+		// DOWNSTREAM //////////////////////////////////////
+
+		// Capabilities we agree to if a spectator asks for them
+		constexpr sf::Uint8 RELAY_CAPABILITIES = CAPABILITY_COMPRESSION_V2;
+
+		// Spectators that have joined (connections still joining do not count)
+		std::size_t CountWatching()
+		{
+			return std::count_if(gSpectators.begin(), gSpectators.end(), [](const ConnectionPtr& s) { return s->status == STATUS_SPECTATING; });
+		}
+
+		// latest: The packet is a state update, which a spectator that is behind only needs the newest of
+		void Broadcast(SharedPacket& p, bool latest = false)
+		{
+			for (auto& spectator : gSpectators)
+			{
+				if (spectator->status == STATUS_SPECTATING && spectator->active)
+					p.SendTo(*spectator, latest);
+			}
+		}
+
+		void AcceptSpectator()
+		{
+			auto spectator = std::make_shared<Connection>();
+
+			if (gListener.accept(spectator->socket) != Status::Done)
+			{
+				debug << "RELAY: There was a failed connection" << std::endl;
+				return;
+			}
+
+			spectator->active = true;
+			spectator->coalesce = true;
+			spectator->status = STATUS_JOINING;
+			spectator->SetBlocking(false);
+			gSelector.add(spectator->socket);
+			gSpectators.push_back(spectator);
+		}
+
+		void ReceiveFromSpectator(ConnectionPtr spectator)
+		{
+			const sf::Uint8* data;
+			std::size_t size;
+			while (spectator->Receive(data, size))
+			{
+				if (size == 0)
+					continue;
+
+				// Spectators cannot influence the game, so all we care about is the join request and clock sync
+				// (relays joining us are treated like any other spectator)
+				switch (data[0])
+				{
+					case PACKET_CLIENT_JOIN:
+					{
+						if (spectator->status != STATUS_JOINING)
+							break;
+
+						// Joins from before PROTOCOL_VERSION do not decode
+						Message<PACKET_CLIENT_JOIN> join;
+						bool isCompatible = Decode(data + 1, size - 1, join) && join.version == PROTOCOL_VERSION;
+
+						if (!isCompatible || CountWatching() >= MAX_SPECTATORS)
+						{
+							spectator->Send(Message<PACKET_SERVER_FULL>());
+							spectator->active = false;
+							break;
+						}
+
+						if (join.capabilities.present)
+							spectator->capabilities = sf::Uint8(join.capabilities.value & RELAY_CAPABILITIES);
+
+						Message<PACKET_SERVER_SPECTATOR> msg;
+						msg.capabilities = spectator->capabilities;
+						spectator->Send(msg);
+						spectator->status = STATUS_SPECTATING;
+
+						if (gLastRate.getDataSize() > 0)
+							spectator->Send(gLastRate);
+						if (!gBacklog.IsEmpty())
+							gBacklog.GetPacket().SendTo(*spectator);
+
+						debug << "RELAY: New spectator, " << CountWatching() << " watching" << std::endl;
+					}
+					break;
+
+					case PACKET_CLIENT_PING:
+					{
+						Message<PACKET_CLIENT_PING> ping;
+						if (spectator->status != STATUS_SPECTATING || !Decode(data + 1, size - 1, ping))
+							break;
+
+						Message<PACKET_SERVER_CLOCK> clock;
+						clock.clientTime = ping.clientTime;
+						clock.serverTime = GetStreamTime();
+						spectator->Send(clock);
+					}
+					break;
+				}
+			}
+		}
+
+		void DropInactiveSpectators()
+		{
+			for (auto& spectator : gSpectators)
+			{
+				if (!spectator->active)
+				{
+					// Whatever it was told last (e.g. that we are full) still goes out
+					spectator->Flush();
+					gSelector.remove(spectator->socket);
+					spectator->Disconnect();
+				}
+			}
+
+			gSpectators.erase(std::remove_if(gSpectators.begin(), gSpectators.end(), [](const auto& s) { return !s->active; }), gSpectators.end());
+		}
+
+		bool StartListening(const sf::IpAddress& address, Port port)
+		{
+			if (gListener.listen(port, address) != Status::Done)
+			{
+				debug << "RELAY: Failed to listen on " << address.toString() << ':' << port << std::endl;
+				return false;
+			}
+
+			debug << "RELAY: Relaying to spectators on " << address.toString() << ':' << port << std::endl;
+
+			gListener.setBlocking(false);
+			gSelector.add(gListener);
+			return true;
+		}
+
+		void PingSpectators()
+		{
+			auto now = the_clock::now();
+			if (now < gNextPingPoint)
+				return;
+
+			gNextPingPoint = now + ms(PING_INTERVAL_MS);
+
+			Message<PACKET_SERVER_PING> ping;
+			ping.serverTime = GetStreamTime();
+
+			SharedPacket p(Encode(ping));
+			Broadcast(p);
+		}
+
+		// Accepts new spectators and handles what the existing ones have sent
+		void ServeSpectators()
+		{
+			if (gSelector.isReady(gListener))
+				AcceptSpectator();
+
+			for (auto& spectator : gSpectators)
+			{
+				if (gSelector.isReady(spectator->socket))
+					ReceiveFromSpectator(spectator);
+			}
+
+			DropInactiveSpectators();
+		}
+
+		// Sends what was queued for each spectator since the last flush as one write, and drops
+		// spectators that have fallen too far behind (there is no slower rate to put them on)
+		void FlushSpectators()
+		{
+			auto now = the_clock::now();
+
+			for (auto& spectator : gSpectators)
+			{
+				spectator->Flush();
+
+				switch (spectator->CheckBackpressure(gBackpressurePolicy, now))
+				{
+					case BACKPRESSURE_OVER_BUDGET:
+						debug << "RELAY: A spectator is falling behind (" << spectator->GetPendingBytes() << " bytes waiting)" << std::endl;
+						break;
+
+					case BACKPRESSURE_DROP:
+						debug << "RELAY: Dropping a spectator that could not keep up (" << spectator->GetPendingBytes() << " bytes waiting)" << std::endl;
+						spectator->active = false;
+						break;
+
+					case BACKPRESSURE_RECOVERED:
+						debug << "RELAY: A spectator has caught up" << std::endl;
+						break;
+
+					default:
+						break;
+				}
+			}
+
+			DropInactiveSpectators();
+		}
+
+		void DisconnectSpectators()
+		{
+			for (auto& spectator : gSpectators)
+				spectator->Disconnect();
+		}
+
+		// UPSTREAM ////////////////////////////////////////
+
+		// p: The packet, decompressed if upstream compressed it
+		// shared: What is passed on to spectators; keeps upstream's compressed form so it is not compressed again
+		// Returns false if we should stop relaying
+		bool HandleUpstreamPacket(const sf::Packet& p, SharedPacket& shared)
+		{
+			if (p.getDataSize() == 0)
+				return true;
+
+			const sf::Uint8* data = static_cast<const sf::Uint8*>(p.getData());
+			std::size_t size = p.getDataSize();
+
+			switch (data[0])
+			{
+				case PACKET_SERVER_SPECTATOR:
+					debug << "RELAY: Joined upstream" << std::endl;
+					gUpstream.status = STATUS_SPECTATING;
+					break;
+
+				case PACKET_SERVER_WELCOME:
+				case PACKET_SERVER_FULL:
+					debug << "RELAY: Upstream would not accept us as a relay" << std::endl;
+					return false;
+
+				case PACKET_SERVER_UPDATE:
+				{
+					// Acknowledge, so upstream picks a rate that suits us
+					Message<PACKET_SERVER_UPDATE> update;
+					if (!Decode(data + 1, size - 1, update))
+						return false;
+
+					Message<PACKET_CLIENT_ACK> ack;
+					ack.serverTime = update.snapshot.serverTime;
+					gUpstream.Send(ack);
+
+					gStreamClock.Seed(update.snapshot.serverTime, GetClockTime());
+
+					gBacklog.Push(update.snapshot);
+					Broadcast(shared, true);
+				}
+				break;
+
+				case PACKET_SERVER_RATE:
+					gLastRate = p;
+					Broadcast(shared);
+					break;
+
+				case PACKET_SERVER_PING:
+				{
+					Message<PACKET_SERVER_PING> ping;
+					if (!Decode(data + 1, size - 1, ping))
+						return false;
+
+					Message<PACKET_CLIENT_PING> response;
+					response.serverTime = ping.serverTime;
+					response.clientTime = GetClockTime();
+					gUpstream.Send(response);
+				}
+				break;
+
+				case PACKET_SERVER_CLOCK:
+				{
+					Message<PACKET_SERVER_CLOCK> clock;
+					if (!Decode(data + 1, size - 1, clock))
+						return false;
+
+					gStreamClock.AddSample(clock.clientTime, clock.serverTime, GetClockTime());
+				}
+				break;
+
+				case PACKET_SERVER_SHOOT:
+					Broadcast(shared);
+					break;
+			}
+
+			return true;
+		}
+
+		// Returns false if we should stop relaying
+		bool ReceiveFromUpstream()
+		{
+			const sf::Uint8* data;
+			std::size_t size;
+			while (gUpstream.Receive(data, size))
+			{
+				if (size == 0)
+					continue;
+
+				// Copied, since it is passed on to spectators as it is
+				sf::Packet p;
+				p.append(data, size);
+
+				bool handled;
+				if (data[0] == PACKET_SERVER_COMPRESSED)
+				{
+					sf::Packet inner;
+					if (!DecompressPacket(data + 1, size - 1, inner))
+						return false;
+
+					SharedPacket shared(inner, p);
+					handled = HandleUpstreamPacket(inner, shared);
+				}
+				else
+				{
+					SharedPacket shared(p);
+					handled = HandleUpstreamPacket(p, shared);
+				}
+
+				if (!handled)
+					return false;
+			}
+
+			return gUpstream.active;
+		}
+
+		bool RunRelay(const sf::IpAddress& upstreamAddress, Port upstreamPort, const std::string& key, const sf::IpAddress& address, Port port)
+		{
+			gStartTime = the_clock::now();
+
+			debug << "RELAY: Connecting to " << upstreamAddress.toString() << ':' << upstreamPort << std::endl;
+			if (!gUpstream.Connect(upstreamAddress, upstreamPort))
+			{
+				debug << "RELAY: Failed to connect upstream" << std::endl;
+				return false;
+			}
+
+			if (!StartListening(address, port))
+				return false;
+
+			gUpstream.SetBlocking(false);
+			gSelector.add(gUpstream.socket);
+
+			Message<PACKET_CLIENT_JOIN> join;
+			join.relay = true;
+			join.capabilities = CAPABILITY_COMPRESSION_V2;
+			join.relayKey = std::vector<sf::Uint8>(key.begin(), key.end());
+			gUpstream.Send(join);
+			gUpstream.status = STATUS_JOINING;
+
+			while (true)
+			{
+				PingSpectators();
+
+				if (gSelector.wait(sf::milliseconds(WAIT_TIME_MS)))
+				{
+					if (gSelector.isReady(gUpstream.socket) && !ReceiveFromUpstream())
+						break;
+
+					ServeSpectators();
+				}
+
+				FlushSpectators();
+			}
+
+			debug << "RELAY: Lost upstream, closing" << std::endl;
+
+			DisconnectSpectators();
+			gUpstream.Disconnect();
+
+			return true;
+		}
+
+		// PLAYBACK ////////////////////////////////////////
+
+		bool RunPlayback(const std::string& path, const sf::IpAddress& address, Port port)
+		{
+			Recording::Reader reader;
+			if (!reader.Open(path))
+			{
+				debug << "RELAY: Could not open recording " << path << std::endl;
+				return false;
+			}
+
+			if (!StartListening(address, port))
+				return false;
+
+			debug << "RELAY: Playing back " << path << std::endl;
+
+			Message<PACKET_SERVER_RATE> rate;
+			rate.updateInterval = PLAYBACK_UPDATE_INTERVAL_MS;
+			gLastRate = Encode(rate);
+
+			// The recording is played back in real time from when the relay started, and its clock is the one spectators synchronise with
+			gStartTime = the_clock::now();
+			gStreamClock.Seed(reader.GetStartTime(), 0);
+
+			sf::Uint64 lastUpdateTime = 0;
+			std::vector<Recording::Shot> shots;
+
+			bool isPlaying = true;
+			while (isPlaying)
+			{
+				PingSpectators();
+
+				if (gSelector.wait(sf::milliseconds(WAIT_TIME_MS)))
+					ServeSpectators();
+
+				sf::Uint64 time = GetStreamTime();
+				isPlaying = reader.Advance(time, &shots) || time < reader.GetEndTime();
+
+				// Played back through the same path as updates from upstream
+				for (const auto& shot : shots)
+				{
+					SharedPacket p(Encode(shot));
+					Broadcast(p);
+				}
+				shots.clear();
+
+				const WorldSnapshot& snapshot = reader.GetSnapshot();
+				if (snapshot.serverTime != lastUpdateTime)
+				{
+					lastUpdateTime = snapshot.serverTime;
+
+					Message<PACKET_SERVER_UPDATE> update;
+					update.snapshot = snapshot;
+					update.complete = true;
+
+					SharedPacket p(Encode(update));
+					gBacklog.Push(snapshot);
+					Broadcast(p, true);
+				}
+
+				FlushSpectators();
+			}
+
+			debug << "RELAY: End of recording, closing" << std::endl;
+
+			DisconnectSpectators();
+			return true;
+		}
+	}
+}
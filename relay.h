@@ -0,0 +1,19 @@
+#pragma once
+#include "network.h"
+
+// relay.h: Joins a game server (or another relay) as a spectator, and re-broadcasts what it receives
+//			to spectators of its own
+
+namespace Network
+{
+	namespace Relay
+	{
+		// Runs until the upstream connection is lost
+		// key: The relay key upstream was given
+		bool RunRelay(const sf::IpAddress& upstreamAddress, Port upstreamPort, const std::string& key, const sf::IpAddress& address, Port port);
+
+		// Serves a recorded match to spectators as if it were being played live
+		// Runs until the end of the recording
+		bool RunPlayback(const std::string& path, const sf::IpAddress& address, Port port);
+	}
+}
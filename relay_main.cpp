@@ -0,0 +1,38 @@
+#include "relay.h"
+#include <cstring>
+#include "debug.h"
+using namespace Network;
+
+// Usage: networking-relay [--key <secret>] <upstream ip> <upstream port> [listen port]
+//		  networking-relay --playback <recording> [listen port]
+
+constexpr Port DEFAULT_RELAY_PORT = 11224;
+
+int main(int argc, const char* argv[])
+{
+	// The game server's relay key (see Server::SetRelayKey)
+	std::string key;
+	if (argc > 2 && std::strcmp(argv[1], "--key") == 0)
+	{
+		key = argv[2];
+		argv += 2;
+		argc -= 2;
+	}
+
+	if (argc < 3)
+	{
+		debug << "Usage: " << argv[0] << " [--key <secret>] <upstream ip> <upstream port> [listen port]\n" <<
+				 "       " << argv[0] << " --playback <recording> [listen port]" << std::endl;
+		return 1;
+	}
+
+	Port port = (argc > 3) ? atoi(argv[3]) : DEFAULT_RELAY_PORT;
+
+	if (std::strcmp(argv[1], "--playback") == 0)
+		return Relay::RunPlayback(argv[2], sf::IpAddress::Any, port) ? 0 : 1;
+
+	std::string upstreamip = argv[1];
+	Port upstreamport = atoi(argv[2]);
+
+	return Relay::RunRelay({ upstreamip }, upstreamport, key, sf::IpAddress::Any, port) ? 0 : 1;
+}
@@ -0,0 +1,40 @@
+#include "render.h"
+#include "common.h"
+
+void RenderWorld(const World& world, sf::RenderWindow& window, bool showServerBullets)
+{
+	sf::RectangleShape shape({ PADDLE_W, PADDLE_H });
+	shape.setOrigin({ H_PADDLE_W, H_PADDLE_H });
+
+	for (const auto& player : world.GetPlayers())
+	{
+		shape.setFillColor(sf::Color(player.GetColour()));
+		shape.setPosition(ToFloat(player.GetPosition()));
+		window.draw(shape);
+	}
+
+	// NOTE: Objects should really just store their own size, or have their own renderable shapes
+	shape.setSize({ BULLET_W, BULLET_H });
+	shape.setOrigin({ H_BULLET_W, H_BULLET_H });
+	for (const auto& bullets : { &world.GetBullets(), &world.GetPredictedBullets() })
+	{
+		for (const auto& bullet : *bullets)
+		{
+			shape.setFillColor(sf::Color(bullet.GetColour()));
+			shape.setPosition(ToFloat(bullet.GetPosition()));
+			window.draw(shape);
+		}
+	}
+
+	if (showServerBullets)
+	{
+		shape.setFillColor(sf::Color(0x00000000));
+		shape.setOutlineThickness(1.f);
+		for (const auto& bullet : world.GetServerBullets())
+		{
+			shape.setOutlineColor(sf::Color(0xA0A0FFFF));
+			shape.setPosition(ToFloat(bullet.GetPosition()));
+			window.draw(shape);
+		}
+	}
+}
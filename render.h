@@ -0,0 +1,11 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include "world.h"
+
+// render.h: Drawing the game, for the front ends that have a window (the client and playback)
+//			 Kept out of world.h, so the simulation builds without SFML's graphics and window modules
+
+// SFML Shortcuts
+using Key = sf::Keyboard::Key;
+
+void RenderWorld(const World& world, sf::RenderWindow& window, bool showServerBullets = false);
@@ -1,9 +1,14 @@
 #include "server.h"
 #include <thread>
-#include <functional>
+#include <mutex>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include "common.h"
-#include "world.h"
-#include "command.h"
+#include "messages.h"
+#include "backlog.h"
+#include "recording.h"
+#include "handoff.h"
 #include "debug.h"
 
 namespace Network
@@ -13,17 +18,43 @@ namespace Network
 		// Global Varaibles //////
 		constexpr int MAX_CLIENTS = 12;
 
+		// Relays are sent every bullet at their full rate, so only a few are let in
+		constexpr int MAX_RELAYS = 4;
+
 		// Time to wait at socket selector
 		constexpr int WAIT_TIME_MS = 10;
 
-		// State update interval
-		constexpr int UPDATE_INTERVAL_MS = 50;
+		// The longest we sleep for when there is nothing to simulate (see IdleWait)
+		constexpr int MAX_IDLE_WAIT_MS = 1000;
+
+		// Capabilities we agree to if a client asks for them
+		constexpr sf::Uint8 SERVER_CAPABILITIES = CAPABILITY_COMPRESSION_V2 | CAPABILITY_SPAWN_TOKENS | CAPABILITY_CHECKSUMS | CAPABILITY_INPUT_TIMES;
+
+		// Bounds for each connection's state update interval (see RateController)
+		constexpr int MIN_UPDATE_INTERVAL_MS = 33;
+		constexpr int MAX_UPDATE_INTERVAL_MS = 250;
 
 		constexpr int PING_INTERVAL_MS = 250;
 
+		// Time between each client's input latencies going to the log
+		constexpr int LATENCY_REPORT_INTERVAL_MS = 10000;
+
+		// The most a single state update may take up; bullets that do not fit wait for a later update
+		constexpr std::size_t SNAPSHOT_BUDGET_BYTES = 1200;
+
+		// Spectators share a single, slower stream of state updates
+		constexpr int MIN_SPECTATOR_UPDATE_INTERVAL_MS = 100;
+		constexpr int MAX_SPECTATOR_UPDATE_INTERVAL_MS = 500;
+
+		// History a spectator receives when joining; needs to cover its interpolation delay
+		constexpr int SPECTATOR_BACKLOG_MS = 1600;
+
 		// How long to hold onto snapshots
 		constexpr int SNAPSHOT_RETENTION_MS = 1000;
 
+		// Time between snapshots written to the recording
+		constexpr int RECORD_INTERVAL_MS = 50;
+
 		// The longest frame time the server is willing to accept from a client
 		// NOTE: An SFML window will freeze while it is being moved,
 		// which may cause the server to drop that client
@@ -34,20 +65,61 @@ namespace Network
 		std::atomic<bool> gIsServerRunning;
 
 		// Networking
-		sf::TcpListener gListener;
+		Listener gListener;
 		sf::SocketSelector gSelector;
 		std::vector<ConnectionPtr> gConnections;
 
 		time_point gNextPingPoint;
-		time_point gNextUpdatePoint;
+		time_point gNextLatencyReportPoint;
+
+		// What to do about connections that do not keep up with what we send them
+		BackpressurePolicy gBackpressurePolicy;
+
+		// Spectator stream
+		time_point gNextSpectatorUpdatePoint;
+		PriorityAccumulator gSpectatorPriority;
+		SnapshotBacklog gSpectatorBacklog{ ms(SPECTATOR_BACKLOG_MS) };
+
+		// Recording
+		std::string gRecordingPath;
+		Recording::Recorder gRecorder;
+		time_point gNextRecordPoint;
+
+		// Stats (see TakeStats)
+		bool gIsCollectingStats = false;
+		std::mutex gStatsMutex;
+		Stats gStats;
+
+		// Relays have to know this to join as one; none are let in while it is empty
+		std::string gRelayKey;
+
+		// Hot restart (see handoff.h)
+		bool gIsHotRestartEnabled = false;
+		bool gIsResuming = false;
+		std::string gHandoffPath = Handoff::DEFAULT_SOCKET_PATH;
+		std::string gCheckpointPath = Handoff::DEFAULT_CHECKPOINT_PATH;
 
 		// Game
 		World gWorld;
-		ms gElapsedTime;
+
+		// Time since the server started, which every timestamp is measured on
+		time_point gStartTime;
+		us gElapsedTime;
 
 		// Entities' previous positions
 		std::vector<WorldSnapshot> gSnapshots;
 
+		ms ElapsedMs()
+		{
+			return std::chrono::duration_cast<ms>(gElapsedTime);
+		}
+
+		// gElapsedTime is only updated once a frame; clock sync wants to know the time right now
+		sf::Uint64 GetClockTime()
+		{
+			return to_us(gStartTime, the_clock::now()).count();
+		}
+
 		// SEND FUNCTIONS //////////////////////////////////
 
 		DEF_SERVER_SEND(PACKET_SERVER_WELCOME)
@@ -63,11 +135,26 @@ namespace Network
 			// NOTE: Would be better to let the client handle this
 			float rot = (gWorld.IsPlayerTopLane(connection->pid)) ? 180.f : 0.f;
 
-			auto p = InitPacket(PACKET_SERVER_WELCOME);
-			p << connection->pid << rot;
+			Message<PACKET_SERVER_WELCOME> msg;
+			msg.pid = connection->pid;
+			msg.rotation = rot;
+			msg.capabilities = connection->capabilities;
 
 			connection->status = STATUS_PLAYING;
-			connection->Send(p);
+			connection->Send(msg);
+		}
+
+		DEF_SERVER_SEND(PACKET_SERVER_RATE)
+		{
+			//// Let the client know how often it will receive state updates, so it can adjust its interpolation delay
+
+			if (connection->status != STATUS_PLAYING && connection->status != STATUS_SPECTATING)
+				return;
+
+			Message<PACKET_SERVER_RATE> msg;
+			msg.updateInterval = sf::Uint16(connection->rate.GetInterval().count());
+
+			connection->Send(msg);
 		}
 
 		DEF_SERVER_SEND(PACKET_SERVER_SPECTATOR)
@@ -77,10 +164,22 @@ namespace Network
 			if (connection->status != STATUS_JOINING)
 				return;
 
-			auto p = InitPacket(PACKET_SERVER_SPECTATOR);
+			Message<PACKET_SERVER_SPECTATOR> msg;
+			msg.capabilities = connection->capabilities;
 
 			connection->status = STATUS_SPECTATING;
-			connection->Send(p);
+			connection->Send(msg);
+
+			// Relays keep up with the players' stream
+			if (connection->relay)
+				return;
+
+			connection->rate.SetBounds(ms(MIN_SPECTATOR_UPDATE_INTERVAL_MS), ms(MAX_SPECTATOR_UPDATE_INTERVAL_MS));
+			SEND(PACKET_SERVER_RATE)(connection);
+
+			// Give the spectator something to show straight away
+			if (!gSpectatorBacklog.IsEmpty())
+				gSpectatorBacklog.GetPacket().SendTo(*connection);
 		}
 
 		DEF_SERVER_SEND(PACKET_SERVER_FULL)
@@ -90,26 +189,34 @@ namespace Network
 			if (connection->status != STATUS_JOINING)
 				return;
 
-			auto p = InitPacket(PACKET_SERVER_FULL);
-
 			debug << "SERVER: A client tried to join, but we are full" << std::endl;
-			connection->Send(p);
+			connection->Send(Message<PACKET_SERVER_FULL>());
 		}
 
-		DEF_SEND_PARAM(PACKET_SERVER_PING)(ConnectionPtr connection, sf::Uint64 timestamp, bool pingBack)
+		DEF_SERVER_SEND(PACKET_SERVER_PING)
 		{
-			//// Respond to a client's ping message by sending back the time they sent their ping
-			// pingBack: If we want the client to ping us back
-			// timestamp: if pingBack is true, this is the server's timestamp
-			//			  if pingBack is false, it is the client's timestamp
+			//// Ask the client to ping us back, so we can measure the round trip time
+			// GetClockTime(): Our timestamp, which the client sends back
 
-			if (connection->status != STATUS_PLAYING)
+			if (connection->status != STATUS_PLAYING && connection->status != STATUS_SPECTATING)
 				return;
 
-			auto p = InitPacket(PACKET_SERVER_PING);
-			p << pingBack << timestamp;
+			Message<PACKET_SERVER_PING> msg;
+			msg.serverTime = GetClockTime();
+
+			connection->Send(msg);
+		}
+
+		DEF_SEND_PARAM(PACKET_SERVER_CLOCK)(ConnectionPtr connection, sf::Uint64 clientTime)
+		{
+			//// Answer the client's clock sync request with our clock
+			// clientTime: The client's timestamp from its request
+
+			Message<PACKET_SERVER_CLOCK> msg;
+			msg.clientTime = clientTime;
+			msg.serverTime = GetClockTime();
 
-			connection->Send(p);
+			connection->Send(msg);
 		}
 
 		DEF_SEND_PARAM(PACKET_SERVER_UPDATE)(ConnectionPtr connection, const WorldSnapshot& snapshot)
@@ -122,26 +229,152 @@ namespace Network
 			if (connection->status == STATUS_JOINING || connection->status == STATUS_NONE)
 				return;
 
-			auto p = InitPacket(PACKET_SERVER_UPDATE);
-			p << snapshot;
+			Message<PACKET_SERVER_UPDATE> msg;
+			msg.snapshot.serverTime = snapshot.serverTime;
+
+			// Players always go in; what is left of the budget goes to the most important bullets
+			msg.snapshot.snapshot = snapshot.snapshot.WithBullets({});
 
-			connection->Send(p);
+			// A client that checks its bullets against ours already has them (it hears about new ones as they are fired,
+			// and moves them along itself), so it is only sent the players, until it tells us otherwise
+			bool isChecked = connection->Accepts(CAPABILITY_CHECKSUMS);
+			if (isChecked)
+			{
+				msg.checksum = snapshot.snapshot.GetBulletChecksum();
+
+				if (!connection->needsFullState)
+				{
+					msg.complete = snapshot.snapshot.GetBullets().empty();
+					sf::Packet packet = Encode(msg);
+					connection->rate.OnSnapshotSent(snapshot.serverTime, connection->SendCompressible(packet), ElapsedMs());
+					return;
+				}
+			}
+
+			std::size_t baseSize = EncodedSize(msg);
+			std::size_t budget = (SNAPSHOT_BUDGET_BYTES > baseSize) ? SNAPSHOT_BUDGET_BYTES - baseSize : 0;
+
+			// Relays pass updates on to spectators who may have just joined, so they always get everything
+			std::vector<std::size_t> bullets;
+			if (!connection->relay)
+				bullets = connection->priority.SelectBullets(snapshot.snapshot, connection->pid, connection->rate.GetTimeSinceSent(ElapsedMs()), budget);
+
+			msg.complete = connection->relay || (bullets.size() == snapshot.snapshot.GetBullets().size());
+			msg.snapshot.snapshot = msg.complete ? snapshot.snapshot : snapshot.snapshot.WithBullets(bullets);
+
+			if (isChecked && msg.complete)
+				connection->needsFullState = false;
+
+			sf::Packet packet = Encode(msg);
+			connection->rate.OnSnapshotSent(snapshot.serverTime, connection->SendCompressible(packet), ElapsedMs());
 		}
 
-		DEF_SEND_PARAM(PACKET_SERVER_SHOOT)(ConnectionPtr connection, const Bullet& bullet)
+		DEF_SEND_PARAM(PACKET_SERVER_UPDATE)(ConnectionPtr connection, SharedPacket& packet, sf::Uint64 serverTime)
+		{
+			//// Send a spectator the shared spectator stream's state update
+			// packet: The encoded update, shared by every spectator
+			// serverTime: The update's timestamp
+
+			if (connection->status != STATUS_SPECTATING)
+				return;
+
+			connection->rate.OnSnapshotSent(serverTime, packet.SendTo(*connection, true), ElapsedMs());
+		}
+
+		DEF_SEND_PARAM(PACKET_SERVER_SHOOT)(ConnectionPtr connection, const Bullet& bullet, Trailing<sf::Uint32> spawnToken = {})
 		{
 			//// Inform a client that a bullet has been fired
 			// bullet: The bullet in question
 			// gElapsedTime.count(): Timestamp of when the bullet was spawned
+			// spawnToken: The shooter's token for the bullet it predicted (only sent to the shooter)
+
+			Message<PACKET_SERVER_SHOOT> msg;
+			msg.bullet = bullet;
+			msg.serverTime = gElapsedTime.count();
+			msg.spawnToken = spawnToken;
+
+			connection->Send(msg);
+		}
+
+		// Spectators (but not relays) receive the shared spectator stream
+		bool IsSpectatorStream(const ConnectionPtr& connection)
+		{
+			return connection->status == STATUS_SPECTATING && !connection->relay;
+		}
+
+		// Encodes the spectator stream's next update; every spectator weighs bullets the same,
+		// so a single priority accumulator serves them all
+		SharedPacket BuildSpectatorUpdate(const WorldSnapshot& snapshot)
+		{
+			Message<PACKET_SERVER_UPDATE> msg;
+			msg.snapshot.serverTime = snapshot.serverTime;
+			msg.snapshot.snapshot = snapshot.snapshot.WithBullets({});
 
-			auto p = InitPacket(PACKET_SERVER_SHOOT);
-			p << bullet << sf::Uint64(gElapsedTime.count());
+			std::size_t baseSize = EncodedSize(msg);
+			std::size_t budget = (SNAPSHOT_BUDGET_BYTES > baseSize) ? SNAPSHOT_BUDGET_BYTES - baseSize : 0;
 
-			connection->Send(p);
+			auto bullets = gSpectatorPriority.SelectBullets(snapshot.snapshot, INVALID_ENTITY, ms(MIN_SPECTATOR_UPDATE_INTERVAL_MS), budget);
+
+			// The update goes out to every spectator, rather than through any one connection's queue
+			gSpectatorPriority.OnUpdateQueued();
+			gSpectatorPriority.OnUpdateSent();
+
+			msg.complete = (bullets.size() == snapshot.snapshot.GetBullets().size());
+			msg.snapshot.snapshot = msg.complete ? snapshot.snapshot : snapshot.snapshot.WithBullets(bullets);
+
+			return SharedPacket(Encode(msg));
+		}
+
+		// Stores the world as it is now
+		// If the clock has not moved on since the last snapshot, that one is replaced rather than joined by another one
+		// with the same time, which DeleteOldSnapshots would never get round to
+		const WorldSnapshot& TakeSnapshot()
+		{
+			WorldSnapshot ss;
+			ss.snapshot = gWorld;
+			ss.serverTime = gElapsedTime.count();
+			if (!gSnapshots.empty() && gSnapshots.back().serverTime >= ss.serverTime)
+				gSnapshots.back() = ss;
+			else
+				gSnapshots.push_back(ss);
+
+			return gSnapshots.back();
+		}
+
+		// Compares every byte, so how long it takes does not give away how much of the key was right
+		bool IsRelayKey(const std::vector<sf::Uint8>& key)
+		{
+			if (gRelayKey.empty() || key.size() != gRelayKey.size())
+				return false;
+
+			sf::Uint8 difference = 0;
+			for (std::size_t i = 0; i < key.size(); ++i)
+				difference |= sf::Uint8(key[i] ^ sf::Uint8(gRelayKey[i]));
+
+			return difference == 0;
+		}
+
+		std::size_t CountRelays()
+		{
+			return std::count_if(gConnections.begin(), gConnections.end(), [](const auto& connection) { return connection->relay; });
+		}
+
+		// Number of connections that are not relays
+		std::size_t CountClients()
+		{
+			return std::count_if(gConnections.begin(), gConnections.end(), [](const auto& connection) { return !connection->relay; });
 		}
 
 		// RECEIVE FUNCTIONS ///////////////////////////////
 
+		// Every packet type sent to the server needs a DEF_SERVER_RECV specialisation,
+		// the dispatch table below will not compile otherwise
+		template<PacketType TYPE>
+		void Receive(ConnectionPtr connection, const Message<TYPE>& p)
+		{
+			static_assert(NO_HANDLER<TYPE>, "Missing server receive function for packet type");
+		}
+
 		DEF_SERVER_RECV(PACKET_CLIENT_JOIN)
 		{
 			//// Packet sent by client requesting to join our server
@@ -149,6 +382,37 @@ namespace Network
 			if (connection->status != STATUS_JOINING)
 				return;
 
+			if (p.version != PROTOCOL_VERSION)
+			{
+				debug << "SERVER: Turned a client away (it speaks protocol version " << p.version << ", we speak " << PROTOCOL_VERSION << ')' << std::endl;
+				SEND(PACKET_SERVER_FULL)(connection);
+				connection->active = false;
+				return;
+			}
+
+			// Agree to whichever capabilities we support (clients that ask for none are not told about any)
+			if (p.capabilities.present)
+				connection->capabilities = sf::Uint8(p.capabilities.value & SERVER_CAPABILITIES);
+
+			// Relays never play, and do not take up a client slot, but they are sent everything,
+			// so only those that know the relay key are let in, and only a few of them
+			if (p.relay)
+			{
+				if (!p.relayKey.present || !IsRelayKey(p.relayKey.value) || CountRelays() >= MAX_RELAYS)
+				{
+					debug << "SERVER: Turned a relay away (" << (CountRelays() >= MAX_RELAYS ? "too many relays" : "wrong relay key") << ')' << std::endl;
+					SEND(PACKET_SERVER_FULL)(connection);
+					connection->active = false;
+					return;
+				}
+
+				connection->relay = true;
+
+				debug << "SERVER: A relay joined" << std::endl;
+				SEND(PACKET_SERVER_SPECTATOR)(connection);
+				return;
+			}
+
 			Player player;
 
 			// Arbitrarily decide a colour for the player
@@ -168,12 +432,17 @@ namespace Network
 			if (gWorld.AddPlayer(player))
 			{
 				connection->pid = player.GetID();
+				connection->joinTime = gElapsedTime.count();
+
+				// Their first shot may arrive before the next tick (an idle server has no snapshots at all),
+				// and needs a snapshot from when they joined to be placed in
+				TakeSnapshot();
 
-				debug << "SERVER: Sent client #" << (int) player.GetID() << " welcome packet" << std::endl;
+				debug << "SERVER: Sent client #" << player.GetID() << " welcome packet" << std::endl;
 				SEND(PACKET_SERVER_WELCOME)(connection);
 			}
 			// Try letting the client spectate
-			else if (gConnections.size() < MAX_CLIENTS)
+			else if (CountClients() < MAX_CLIENTS)
 			{
 				debug << "SERVER: Reached MAX_PLAYERS, new spectator joined" << std::endl;
 				SEND(PACKET_SERVER_SPECTATOR)(connection);
@@ -194,13 +463,12 @@ namespace Network
 			if (connection->status != STATUS_PLAYING)
 				return;
 
-			Command cmd;
-			p >> cmd;
+			const Command& cmd = p.cmd;
 
 			// Do not allow the client to move too far
 			if (cmd.dt > COMMAND_FRAME_TIME_TRESHOLD_MS)
 			{
-				debug << "SERVER: Client #" << (int) connection->pid << " was dropped because of too high frame time (" << cmd.dt << ')' << std::endl;
+				debug << "SERVER: Client #" << connection->pid << " was dropped because of too high frame time (" << cmd.dt << ')' << std::endl;
 				// Assume they are trying to cheat and disconnect the client
 				// TODO: Send the client an error message, letting them know why they disconnected
 				connection->active = false;
@@ -208,6 +476,20 @@ namespace Network
 			}
 
 			gWorld.RunCommand(cmd, connection->pid, false);
+
+			// The client's clock is synchronised with ours, so the time it says it input the command at is comparable with ours
+			if (p.inputTime.present && connection->Accepts(CAPABILITY_INPUT_TIMES))
+			{
+				sf::Uint64 now = GetClockTime();
+				us latency(now > p.inputTime.value ? now - p.inputTime.value : 0);
+				connection->inputLatency.Record(latency);
+
+				if (gIsCollectingStats)
+				{
+					std::lock_guard<std::mutex> lock(gStatsMutex);
+					gStats.inputLatency.Record(latency);
+				}
+			}
 		}
 
 		DEF_SERVER_RECV(PACKET_CLIENT_PING)
@@ -216,27 +498,30 @@ namespace Network
 			// serverTime: Our initial ping-packet's timestamp
 			// clientTime: The client's timestamp
 
-			if (connection->status != STATUS_PLAYING)
+			if (connection->status != STATUS_PLAYING && connection->status != STATUS_SPECTATING)
 				return;
 
-			sf::Uint64 serverTime, clientTime;
-			p >> serverTime >> clientTime;
-
-			connection->latency = gElapsedTime - ms(serverTime);
+			connection->clock.AddSample(p.serverTime, p.clientTime, GetClockTime());
 
-			SEND(PACKET_SERVER_PING)(connection, clientTime, false);
+			SEND(PACKET_SERVER_CLOCK)(connection, p.clientTime);
 		}
 
 		DEF_SERVER_RECV(PACKET_CLIENT_SHOOT)
 		{
 			//// A request* from a client to fire a bullet
 			//// * = As long as the client is a player, the server never says no
+			// serverTime: When the client fired, on our clock
+			// spawnToken: The client's name for the bullet it predicted, which we send back to it
 
 			if (connection->status != STATUS_PLAYING)
 				return;
 
-			// The time at which the shot was fired by the client
-			sf::Uint64 shotFiredTime = gElapsedTime.count() - connection->latency.count();
+			// The time at which the shot was fired by the client; the client's clock is synchronised with ours,
+			// but it is not trusted to claim a time in the future, before it joined, or further back than we keep snapshots for
+			// (a client that has only just joined may fire before its clock is synchronised at all)
+			sf::Uint64 now = gElapsedTime.count();
+			sf::Uint64 oldest = gSnapshots.empty() ? now : gSnapshots.front().serverTime;
+			sf::Uint64 shotFiredTime = std::min(std::max({ p.serverTime, oldest, connection->joinTime }), now);
 
 			// Find the snapshot where the bullet was fired
 			auto snapshotIterator = std::find_if(gSnapshots.begin(), gSnapshots.end(), [&](const auto& ss) {
@@ -247,24 +532,34 @@ namespace Network
 			if (snapshotIterator == gSnapshots.end())
 			{
 				// Disconnect the client
-				debug << "SERVER: Client #" << (int) connection->pid << " requested to fire a bullet, but the snapshot was lost" << std::endl;
+				debug << "SERVER: Client #" << connection->pid << " requested to fire a bullet, but the snapshot was lost" << std::endl;
 				// TODO: Let the client know why they disconnected
 				connection->active = false;
 				return;
 			}
 			
-			World shotFiredSnapshot = snapshotIterator->snapshot;
+			// Snapshots share their entities with the live world, so there is no need to copy it
+			const World& shotFiredSnapshot = snapshotIterator->snapshot;
 
 			// How far the bullet has travelled since it was fired by the client
-			float travelledDistance = Bullet::BULLET_SPEED * connection->latency.count() / 1000.f;
+			Scalar travelledDistance = DistanceIn(Bullet::BULLET_SPEED, us(now - shotFiredTime));
 
 			// The place where the bullet was fired from (does not take client-side prediction into account)
-			auto bulletPosition = shotFiredSnapshot.GetPlayer(connection->pid)->GetPosition();
+			// The snapshot taken in the tick the player joined may not hold it yet, in which case it fires from where it is now
+			const Player* shooter = shotFiredSnapshot.GetPlayer(connection->pid);
+			if (!shooter)
+				shooter = static_cast<const World&>(gWorld).GetPlayer(connection->pid);
+
+			if (!shooter)
+				return;
+
+			auto bulletPosition = shooter->GetPosition();
 
 			// Move the bullet to the y-coordinate we expect it to be on the client's screen
 			bulletPosition.y += (gWorld.IsPlayerTopLane(connection->pid) ? travelledDistance : -travelledDistance);
 
 			Bullet bullet = gWorld.PlayerShoot(connection->pid, bulletPosition);
+			gRecorder.RecordShot(bullet, gElapsedTime.count());
 
 			// Inform the other clients that a bullet has been fired
 			for (auto& otherConnection : gConnections)
@@ -272,22 +567,71 @@ namespace Network
 				if (otherConnection != connection)
 					SEND(PACKET_SERVER_SHOOT)(otherConnection, bullet);
 			}
+
+			// Tell the shooter which bullet is ours, so it can take the place of the one it predicted
+			if (p.spawnToken.present && connection->Accepts(CAPABILITY_SPAWN_TOKENS))
+				SEND(PACKET_SERVER_SHOOT)(connection, bullet, p.spawnToken);
 		}
 
-		using ServerReceiveCallback = std::function<void(ConnectionPtr, sf::Packet&)>;
-		const ServerReceiveCallback gReceivePacket[] = {
-				RECV(PACKET_CLIENT_JOIN),
-				nullptr,					// PACKET_SERVER_WELCOME
-				nullptr,					// PACKET_SERVER_SPECTATOR
-				nullptr,					// PACKET_SERVER_FULL
-				RECV(PACKET_CLIENT_CMD),
-				nullptr,					// PACKET_SERVER_PING
-				RECV(PACKET_CLIENT_PING),
-				nullptr,					// PACKET_SERVER_UPDATE
-				RECV(PACKET_CLIENT_SHOOT),
-				nullptr,					// PACKET_SERVER_SHOOT
+		DEF_SERVER_RECV(PACKET_CLIENT_ACK)
+		{
+			//// The client has received a state update
+			// serverTime: Timestamp of the newest snapshot it has
+
+			if (connection->status != STATUS_PLAYING && connection->status != STATUS_SPECTATING)
+				return;
+
+			ms rtt = std::chrono::duration_cast<ms>(connection->clock.GetRtt());
+			// Data waiting in our own queue is queued on the link just the same as data in the OS send buffer
+			std::size_t queuedBytes = connection->socket.GetQueuedBytes() + connection->GetPendingBytes();
+			if (connection->rate.OnSnapshotAcked(p.serverTime, ElapsedMs(), rtt, queuedBytes))
+			{
+				debug << "SERVER: Client #" << connection->pid << " now receives updates every " << connection->rate.GetInterval().count() << "ms" <<
+					" (round trip " << rtt.count() << "ms, ~" << (int) (connection->rate.GetBandwidth() * 1000.f) << " B/s)" << std::endl;
+
+				SEND(PACKET_SERVER_RATE)(connection);
+			}
+		}
+
+		DEF_SERVER_RECV(PACKET_CLIENT_RESYNC)
+		{
+			//// The client's bullets no longer match ours (see CAPABILITY_CHECKSUMS)
+
+			if (connection->status != STATUS_PLAYING || !connection->Accepts(CAPABILITY_CHECKSUMS))
+				return;
+
+			if (!connection->needsFullState)
+				debug << "SERVER: Client #" << connection->pid << " is out of sync, sending it every bullet" << std::endl;
+
+			connection->needsFullState = true;
+		}
+
+		// Decodes a packet's payload and hands it to its receive function
+		template<PacketType TYPE>
+		struct ReceiveEntry
+		{
+			static void Call(ConnectionPtr connection, const sf::Uint8* data, std::size_t size)
+			{
+				Message<TYPE> msg;
+				if (!Decode(data, size, msg))
+				{
+					debug << "SERVER: Client #" << connection->pid << " sent a malformed packet (type " << TYPE << ')' << std::endl;
+
+					// Joins from before PROTOCOL_VERSION do not decode, but can still be told no
+					if constexpr (TYPE == PACKET_CLIENT_JOIN)
+						SEND(PACKET_SERVER_FULL)(connection);
+
+					connection->active = false;
+					return;
+				}
+
+				RECV(TYPE)(connection, msg);
+			}
 		};
 
+		using ServerReceiveCallback = void(*)(ConnectionPtr, const sf::Uint8*, std::size_t);
+		constexpr auto gReceivePacket = MakeDispatchTable<ServerReceiveCallback, ReceiveEntry, TO_SERVER>();
+
 		// Server logic ///////
 
 		// NOTE: Sometimes SFML will start listening on the wrong port
@@ -304,30 +648,41 @@ namespace Network
 
 		void AcceptClients()
 		{
-			gConnections.emplace_back(std::make_shared<Connection>());
-			ConnectionPtr newConnection = gConnections.back();
+			ConnectionPtr newConnection = std::make_shared<Connection>();
 
 			auto ret = gListener.accept(newConnection->socket);
 
+			// A failed connection never makes it into gConnections, where it would otherwise stay forever
 			if (ret != Status::Done)
 			{
 				debug << "SERVER: There was a failed connection" << std::endl;
 				return;
 			}
 
+			gConnections.push_back(newConnection);
+
 			debug << "SERVER: Accepted a new client -- " << gConnections.size() << " clients connected" << std::endl;
 
 			// TODO: Set timeout, so connection is dropped if the client does not send a PACKET_CLIENT_JOIN in time
 
 			newConnection->active = true;
+			newConnection->coalesce = true;
 			newConnection->status = STATUS_JOINING;
+			newConnection->rate.SetBounds(ms(MIN_UPDATE_INTERVAL_MS), ms(MAX_UPDATE_INTERVAL_MS));
 			newConnection->SetBlocking(false);
 			gSelector.add(newConnection->socket);
 		}
 
+		void ReportLatency(const ConnectionPtr& connection)
+		{
+			if (connection->inputLatency.GetCount() > 0)
+				debug << "SERVER: Client #" << connection->pid << " input latency: " << connection->inputLatency.Describe() << std::endl;
+		}
+
 		auto DropConnection(ConnectionPtr connection)
 		{
-			debug << "SERVER: Dropping client " << (int) connection->pid << ", " << gConnections.size() - 1 << " clients are currently connected" << std::endl;
+			debug << "SERVER: Dropping client " << connection->pid << ", " << gConnections.size() - 1 << " clients are currently connected" << std::endl;
+			ReportLatency(connection);
 
 			gSelector.remove(connection->socket);
 
@@ -341,24 +696,25 @@ namespace Network
 
 		void Receive(ConnectionPtr connection)
 		{
-			while (true)
+			// Packets are decoded where they were received, without copying them out first
+			const sf::Uint8* data;
+			std::size_t size;
+			while (connection->Receive(data, size))
 			{
-				sf::Packet p;
-				if (!connection->Receive(p))
-					break;
+				if (size == 0)
+					continue;
 
-				sf::Uint8 type;
-				p >> type;
+				sf::Uint8 type = data[0];
 
 				// Call the appropriate receive function based on the packet-type
 				if (type < PACKET_END && gReceivePacket[type] != nullptr && connection->active)
-					gReceivePacket[type](connection, p);
+					gReceivePacket[type](connection, data + 1, size - 1);
 			}
 		}
 
-		void ReceiveFromClients()
+		void ReceiveFromClients(ms wait)
 		{
-			if (!gSelector.wait(sf::milliseconds(WAIT_TIME_MS)))
+			if (!gSelector.wait(sf::milliseconds(sf::Int32(wait.count()))))
 				return;
 
 			if (gSelector.isReady(gListener))
@@ -384,43 +740,142 @@ namespace Network
 			}
 		}
 
-		void UpdateClients()
+		void UpdateClients(time_point now)
 		{
-			// RECODE(?): Using the_clock::now() too much?
-
-			if (the_clock::now() < gNextUpdatePoint)
-				return;
-
-			// Create a snapshot of the server's simulation state
+			// Create a snapshot of the server's simulation state (shares its entities with gWorld)
 			WorldSnapshot snapshot;
 			snapshot.snapshot = gWorld;
 			snapshot.serverTime = gElapsedTime.count();
 
 			// Is it time to ping?
-			bool ping = (the_clock::now() >= gNextPingPoint);
+			bool ping = (now >= gNextPingPoint);
 
 			// Schedule the next ping
 			if (ping)
-				gNextPingPoint = the_clock::now() + ms(PING_INTERVAL_MS);
+				gNextPingPoint = now + ms(PING_INTERVAL_MS);
+
+			// Is it time for the spectator stream to move on?
+			bool spectatorTick = (now >= gNextSpectatorUpdatePoint);
+
+			if (spectatorTick)
+			{
+				gSpectatorBacklog.Push(snapshot);
+				gNextSpectatorUpdatePoint = now + ms(MIN_SPECTATOR_UPDATE_INTERVAL_MS);
+			}
+
+			// Encoded when the first spectator needs it
+			SharedPacket spectatorUpdate;
+			bool hasSpectatorUpdate = false;
 
-			// Send state update to all connected clients
+			// Send state update to the clients that are due one, each at their own rate
 			for (auto& connection : gConnections)
 			{
-				SEND(PACKET_SERVER_UPDATE)(connection, snapshot);
+				if (IsSpectatorStream(connection))
+				{
+					// Spectators can only be sent the stream's updates; a spectator on a slow link skips some
+					if (spectatorTick && now >= connection->nextUpdatePoint)
+					{
+						if (!hasSpectatorUpdate)
+						{
+							spectatorUpdate = BuildSpectatorUpdate(snapshot);
+							hasSpectatorUpdate = true;
+						}
+
+						SEND(PACKET_SERVER_UPDATE)(connection, spectatorUpdate, snapshot.serverTime);
+						connection->nextUpdatePoint = now + connection->rate.GetInterval();
+					}
+				}
+				else if (now >= connection->nextUpdatePoint)
+				{
+					SEND(PACKET_SERVER_UPDATE)(connection, snapshot);
+
+					// Schedule next update
+					connection->nextUpdatePoint = now + connection->rate.GetInterval();
+				}
 
 				if (ping)
-					SEND(PACKET_SERVER_PING)(connection, snapshot.serverTime, true);
+					SEND(PACKET_SERVER_PING)(connection);
+			}
+		}
+
+		// Sends everything queued for each connection this tick (replies, shots, pings and the state update) as one write,
+		// or as much as its socket takes, and deals with connections that have fallen too far behind
+		void FlushClients(time_point now)
+		{
+			for (auto it = gConnections.begin(); it != gConnections.end(); )
+			{
+				ConnectionPtr connection = *it;
+				connection->Flush();
+
+				switch (connection->CheckBackpressure(gBackpressurePolicy, now))
+				{
+					case BACKPRESSURE_OVER_BUDGET:
+						debug << "SERVER: Client #" << connection->pid << " is falling behind (" << connection->GetPendingBytes() << " bytes waiting)" << std::endl;
+						break;
+
+					case BACKPRESSURE_DEMOTE:
+						debug << "SERVER: Client #" << connection->pid << " is still behind, sending it updates at the slowest rate" << std::endl;
+						if (connection->rate.Demote())
+							SEND(PACKET_SERVER_RATE)(connection);
+						break;
+
+					case BACKPRESSURE_DROP:
+						debug << "SERVER: Client #" << connection->pid << " could not keep up (" << connection->GetPendingBytes() << " bytes waiting)" << std::endl;
+						connection->active = false;
+						break;
+
+					case BACKPRESSURE_RECOVERED:
+						debug << "SERVER: Client #" << connection->pid << " has caught up" << std::endl;
+						break;
+
+					default:
+						break;
+				}
+
+				// A client that has stopped reading may well have stopped sending too, so it is dropped here rather than waiting for its socket
+				if (!connection->active)
+				{
+					it = DropConnection(connection);
+					continue;
+				}
+
+				++it;
+			}
+		}
+
+		// Nobody is playing and no bullets are flying, so there is nothing to simulate
+		bool IsIdle()
+		{
+			return gWorld.GetPlayers().empty() && gWorld.GetBullets().empty();
+		}
+
+		// How long an idle server can sleep for: until the next update or ping it has to send, if it has anyone to send them to
+		// A packet or a new connection wakes it up sooner
+		ms IdleWait(time_point now)
+		{
+			time_point wake = now + ms(MAX_IDLE_WAIT_MS);
+
+			for (const auto& connection : gConnections)
+			{
+				// Whatever a backed up socket did not take is retried at the usual pace
+				if (connection->GetPendingBytes() > 0)
+					return ms(WAIT_TIME_MS);
+
+				if (connection->status != STATUS_PLAYING && connection->status != STATUS_SPECTATING)
+					continue;
+
+				wake = std::min(wake, std::max(connection->nextUpdatePoint, IsSpectatorStream(connection) ? gNextSpectatorUpdatePoint : now));
+				wake = std::min(wake, gNextPingPoint);
 			}
 
-			// Schedule next update
-			gNextUpdatePoint = the_clock::now() + ms(UPDATE_INTERVAL_MS);
+			return std::max(ms(0), std::chrono::duration_cast<ms>(wake - now));
 		}
 
 		void DeleteOldSnapshots()
 		{
 			const auto pred = [&](const auto& snapshot)
 			{
-				return (gElapsedTime.count() - snapshot.serverTime) >= SNAPSHOT_RETENTION_MS;
+				return (gElapsedTime.count() - snapshot.serverTime) >= (sf::Uint64) us(ms(SNAPSHOT_RETENTION_MS)).count();
 			};
 
 			gSnapshots.erase(
@@ -429,50 +884,414 @@ namespace Network
 			);
 		}
 
+		void RecordStats(us tickTime)
+		{
+			std::lock_guard<std::mutex> lock(gStatsMutex);
+
+			gStats.connections = gConnections.size();
+			gStats.players = gWorld.GetPlayers().size();
+			gStats.bullets = gWorld.GetBullets().size();
+			gStats.snapshots = gSnapshots.size();
+			gStats.backlogSnapshots = gSpectatorBacklog.GetSize();
+
+			gStats.pendingBytes = 0;
+			for (const auto& connection : gConnections)
+				gStats.pendingBytes += connection->GetPendingBytes();
+
+			gStats.tickTime.Record(tickTime);
+		}
+
+		// HOT RESTART ///////////////////////////////////
+
+		// What a connection needs to carry on in another process; the rest (clock estimates, rate, priorities)
+		// is measured again from scratch
+		struct ConnectionCheckpoint
+		{
+			EntityID pid;
+			sf::Uint8 status;
+			bool relay;
+			bool hasCapabilities;
+			sf::Uint8 capabilities;
+			std::vector<sf::Uint8> pending;	// Queued, but not yet taken by the socket (may start part way into a packet)
+			std::vector<sf::Uint8> unread;	// Received, but not yet handled
+
+			static constexpr auto Fields()
+			{
+				return std::make_tuple(&ConnectionCheckpoint::pid, &ConnectionCheckpoint::status, &ConnectionCheckpoint::relay,
+					&ConnectionCheckpoint::hasCapabilities, &ConnectionCheckpoint::capabilities, &ConnectionCheckpoint::pending, &ConnectionCheckpoint::unread);
+			}
+		};
+
+		// Connections are listed in the same order as the sockets handed over, after the listener
+		struct Checkpoint
+		{
+			sf::Uint64 elapsedTime;
+			World world;
+			World::IdState ids;
+			std::vector<WorldSnapshot> snapshots;
+			std::vector<ConnectionCheckpoint> connections;
+
+			static constexpr auto Fields()
+			{
+				return std::make_tuple(&Checkpoint::elapsedTime, &Checkpoint::world, &Checkpoint::ids, &Checkpoint::snapshots, &Checkpoint::connections);
+			}
+		};
+
+		constexpr char CHECKPOINT_MAGIC[] = { 'N', 'P', 'C', 'K', 'P' };
+		constexpr sf::Uint32 CHECKPOINT_VERSION = 1;
+
+		bool WriteCheckpoint(const std::string& path, const Checkpoint& checkpoint)
+		{
+			using namespace Wire;
+
+			std::vector<sf::Uint8> buffer(sizeof(CHECKPOINT_MAGIC) + Codec<sf::Uint32>::SIZE + Codec<Checkpoint>::Size(checkpoint));
+			std::memcpy(buffer.data(), CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+			sf::Uint8* out = buffer.data() + sizeof(CHECKPOINT_MAGIC);
+			Codec<sf::Uint32>::Write(out, CHECKPOINT_VERSION);
+			Codec<Checkpoint>::Write(out, checkpoint);
+
+			std::FILE* file = std::fopen(path.c_str(), "wb");
+			if (!file)
+			{
+				debug << "SERVER: Could not open " << path << " for writing" << std::endl;
+				return false;
+			}
+
+			bool isWritten = std::fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+			isWritten = (std::fclose(file) == 0) && isWritten;
+			return isWritten;
+		}
+
+		bool ReadCheckpoint(const std::string& path, Checkpoint& checkpoint)
+		{
+			using namespace Wire;
+
+			std::FILE* file = std::fopen(path.c_str(), "rb");
+			if (!file)
+			{
+				debug << "SERVER: Could not open " << path << std::endl;
+				return false;
+			}
+
+			std::vector<sf::Uint8> buffer;
+			sf::Uint8 chunk[4096];
+			std::size_t n;
+			while ((n = std::fread(chunk, 1, sizeof(chunk), file)) > 0)
+				buffer.insert(buffer.end(), chunk, chunk + n);
+
+			std::fclose(file);
+
+			const std::size_t headerSize = sizeof(CHECKPOINT_MAGIC) + Codec<sf::Uint32>::SIZE;
+			if (buffer.size() < headerSize || std::memcmp(buffer.data(), CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0)
+			{
+				debug << "SERVER: " << path << " is not a checkpoint" << std::endl;
+				return false;
+			}
+
+			const sf::Uint8* in = buffer.data() + sizeof(CHECKPOINT_MAGIC);
+			const sf::Uint8* end = buffer.data() + buffer.size();
+
+			sf::Uint32 version;
+			Codec<sf::Uint32>::Read(in, end, version);
+			if (version != CHECKPOINT_VERSION)
+			{
+				debug << "SERVER: " << path << " was written by an incompatible server (version " << version << ')' << std::endl;
+				return false;
+			}
+
+			if (!ReadChecked(in, end, checkpoint) || in != end)
+			{
+				debug << "SERVER: " << path << " is corrupt" << std::endl;
+				return false;
+			}
+
+			return true;
+		}
+
+		// Old process: checkpoints the game and passes every socket on to the process waiting to take over
+		// Returns false, with nothing changed, if there is no such process or it does not take over
+		bool HandOver()
+		{
+			debug << "SERVER: Handing over to " << gHandoffPath << std::endl;
+
+			Checkpoint checkpoint;
+			checkpoint.elapsedTime = gElapsedTime.count();
+			checkpoint.world = gWorld;
+			checkpoint.ids = gWorld.GetIdState();
+			checkpoint.snapshots = gSnapshots;
+
+			std::vector<sf::SocketHandle> handles{ gListener.GetHandle() };
+
+			for (const auto& connection : gConnections)
+			{
+				ConnectionCheckpoint c;
+				c.pid = connection->pid;
+				c.status = sf::Uint8(connection->status);
+				c.relay = connection->relay;
+				c.hasCapabilities = connection->capabilities.present;
+				c.capabilities = connection->capabilities.ValueOr(0);
+				c.pending.assign(connection->outbox.begin() + connection->outboxSent, connection->outbox.end());
+				c.pending.insert(c.pending.end(), connection->latestUpdate.begin(), connection->latestUpdate.end());
+				c.unread = connection->inbox.GetUnread();
+
+				checkpoint.connections.push_back(c);
+				handles.push_back(connection->socket.GetHandle());
+			}
+
+			if (!WriteCheckpoint(gCheckpointPath, checkpoint) || !Handoff::SendHandles(gHandoffPath, handles))
+			{
+				debug << "SERVER: Handoff failed, carrying on" << std::endl;
+				return false;
+			}
+
+			debug << "SERVER: Handed over " << gConnections.size() << " connections" << std::endl;
+			return true;
+		}
+
+		// The old process may still be writing 'path' when this one takes over, so the recording carries on in a file
+		// of its own, named after the time (on the game's clock) it was taken over at: match.rec -> match.123456.rec
+		std::string ResumedRecordingPath(const std::string& path)
+		{
+			std::string suffix = '.' + std::to_string(ElapsedMs().count());
+
+			std::size_t dot = path.find_last_of('.');
+			std::size_t slash = path.find_last_of("/\\");
+			if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+				return path + suffix;
+
+			return path.substr(0, dot) + suffix + path.substr(dot);
+		}
+
+		// New process: waits for the running server to hand over, and picks up where it left off
+		bool TakeOver()
+		{
+			Handoff::Receiver receiver;
+			std::vector<sf::SocketHandle> handles;
+			if (!receiver.Listen(gHandoffPath) || !receiver.Receive(handles))
+				return false;
+
+			// Adopted straight away, so they are closed again if anything below fails
+			gListener.Adopt(handles[0]);
+
+			std::vector<ConnectionPtr> connections;
+			for (std::size_t i = 1; i < handles.size(); ++i)
+			{
+				connections.emplace_back(std::make_shared<Connection>());
+				connections.back()->socket.Adopt(handles[i]);
+			}
+
+			Checkpoint checkpoint;
+			if (!ReadCheckpoint(gCheckpointPath, checkpoint))
+				return false;
+
+			if (checkpoint.connections.size() != connections.size())
+			{
+				debug << "SERVER: Received " << connections.size() << " connections, but the checkpoint has " << checkpoint.connections.size() << std::endl;
+				return false;
+			}
+
+			// Nothing below can fail, so the old process can stop; if it will not, it carries on and this one gives up
+			if (!receiver.Acknowledge())
+				return false;
+
+			gWorld = checkpoint.world;
+			gWorld.RestoreIdState(checkpoint.ids);
+			gSnapshots = checkpoint.snapshots;
+
+			gListener.setBlocking(false);
+			gSelector.add(gListener);
+
+			for (std::size_t i = 0; i < connections.size(); ++i)
+			{
+				const ConnectionCheckpoint& c = checkpoint.connections[i];
+				ConnectionPtr connection = connections[i];
+
+				connection->pid = c.pid;
+				connection->status = ConnectionStatus(c.status);
+				connection->relay = c.relay;
+				if (c.hasCapabilities)
+					connection->capabilities = c.capabilities;
+
+				connection->active = true;
+				connection->coalesce = true;
+				connection->outbox = c.pending;
+				connection->inbox.SetUnread(c.unread);
+
+				if (IsSpectatorStream(connection))
+					connection->rate.SetBounds(ms(MIN_SPECTATOR_UPDATE_INTERVAL_MS), ms(MAX_SPECTATOR_UPDATE_INTERVAL_MS));
+				else
+					connection->rate.SetBounds(ms(MIN_UPDATE_INTERVAL_MS), ms(MAX_UPDATE_INTERVAL_MS));
+
+				connection->SetBlocking(false);
+				gSelector.add(connection->socket);
+				gConnections.push_back(connection);
+			}
+
+			// Carry on the same clock, so the clients' timestamps still mean the same
+			gElapsedTime = us(checkpoint.elapsedTime);
+			gStartTime = the_clock::now() - gElapsedTime;
+
+			debug << "SERVER: Took over " << gConnections.size() << " connections at " << ElapsedMs().count() << "ms" << std::endl;
+
+			// Every connection starts over at its initial update rate
+			for (auto& connection : gConnections)
+			{
+				if (!connection->relay)
+					SEND(PACKET_SERVER_RATE)(connection);
+			}
+
+			return true;
+		}
+
 		// The task to be run in the server thread (main server loop)
 		void ServerTask(const sf::IpAddress& address, Port port)
 		{
 			gIsServerRunning = true;
 
 			gNextPingPoint = the_clock::now() + ms(PING_INTERVAL_MS);
-			gNextUpdatePoint = the_clock::now() + ms(UPDATE_INTERVAL_MS);
+			gNextLatencyReportPoint = the_clock::now() + ms(LATENCY_REPORT_INTERVAL_MS);
 
-			if (!StartListening(address, port))
-				return;
+			if (gIsResuming)
+			{
+				if (!TakeOver())
+				{
+					// The connections were not kept, but the listener was adopted into its global
+					gListener.close();
 
-			ms dt{ 0 };
-			while (gIsServerRunning)
+					debug << "SERVER: Could not take over from the running server" << std::endl;
+					gIsServerRunning = false;
+					return;
+				}
+			}
+			else
 			{
-				auto startFrame = the_clock::now();
+				if (!StartListening(address, port))
+					return;
 
-				ReceiveFromClients();
+				gStartTime = the_clock::now();
+				gElapsedTime = us(0);
+			}
 
-				// Update bullet positions
-				gWorld.Update(dt.count());
+			// A server that took over starts a recording of its own
+			if (!gRecordingPath.empty())
+				gRecorder.Start(gIsResuming ? ResumedRecordingPath(gRecordingPath) : gRecordingPath);
+
+			auto now = the_clock::now();
+			bool wasIdle = false;
+
+			while (gIsServerRunning)
+			{
+				// With nothing to simulate, sleep until a client sends something or something is due to be sent
+				// (the wait is measured from the end of the last tick, which is close enough)
+				ReceiveFromClients(IsIdle() ? IdleWait(now) : ms(WAIT_TIME_MS));
+
+				// Asked again after the wait, since a player may have joined in it: the tick they joined in has to be
+				// simulated, or there is no snapshot yet for their first shot to be placed in
+				bool isIdle = IsIdle();
+				if (isIdle != wasIdle)
+				{
+					debug << "SERVER: " << (isIdle ? "Nothing to simulate, idling" : "Waking up") << std::endl;
+					wasIdle = isIdle;
+				}
+
+				// The clock is read once a tick, and everything in the tick goes by it
+				// Time is measured from the start rather than added up frame by frame, so it does not drift,
+				// and the simulation steps by whole milliseconds without losing the remainders
+				now = the_clock::now();
+				us elapsedTime = to_us(gStartTime, now);
+				ms dt = std::chrono::duration_cast<ms>(elapsedTime) - ElapsedMs();
+				gElapsedTime = elapsedTime;
 
 				DeleteOldSnapshots();
 
-				// Store the current state of the simulation
-				WorldSnapshot ss;
-				ss.snapshot = gWorld;
-				ss.serverTime = gElapsedTime.count();
-				gSnapshots.push_back(ss);
+				if (!isIdle)
+				{
+					// Update bullet positions
+					gWorld.Update(dt.count());
 
-				UpdateClients();
+					// Store the current state of the simulation
+					const WorldSnapshot& ss = TakeSnapshot();
 
-				auto endFrame = the_clock::now();
+					if (gRecorder.IsRecording() && now >= gNextRecordPoint)
+					{
+						gRecorder.RecordSnapshot(ss);
+						gNextRecordPoint = now + ms(RECORD_INTERVAL_MS);
+					}
+				}
+
+				UpdateClients(now);
+				FlushClients(now);
+
+				if (gIsCollectingStats)
+					RecordStats(to_us(now, the_clock::now()));
+
+				// Every client's input latency since it joined, for the log
+				if (now >= gNextLatencyReportPoint)
+				{
+					for (const auto& connection : gConnections)
+						ReportLatency(connection);
 
-				dt = to_ms(startFrame, endFrame);
-				gElapsedTime += dt;
+					gNextLatencyReportPoint = now + ms(LATENCY_REPORT_INTERVAL_MS);
+				}
+
+				// Hand over at the end of a tick, once everything it queued has been flushed
+				if (gIsHotRestartEnabled && Handoff::IsRequested() && HandOver())
+					break;
 			}
 
+			gRecorder.Stop();
 			gIsServerRunning = false;
 		}
 
+		void SetBackpressurePolicy(const BackpressurePolicy& policy)
+		{
+			gBackpressurePolicy = policy;
+		}
+
+		void EnableStats()
+		{
+			gIsCollectingStats = true;
+		}
+
+		Stats TakeStats()
+		{
+			std::lock_guard<std::mutex> lock(gStatsMutex);
+
+			Stats stats = gStats;
+			gStats.tickTime.Reset();
+			gStats.inputLatency.Reset();
+			return stats;
+		}
+
+		void EnableHotRestart(const std::string& socketPath, const std::string& checkpointPath)
+		{
+			gIsHotRestartEnabled = true;
+			gHandoffPath = socketPath;
+			gCheckpointPath = checkpointPath;
+
+			Handoff::InstallSignalHandler();
+		}
+
+		void SetResuming(bool resume)
+		{
+			gIsResuming = resume;
+		}
+
+		void SetRelayKey(const std::string& key)
+		{
+			gRelayKey = key;
+		}
+
+		void SetRecordingPath(const std::string& path)
+		{
+			gRecordingPath = path;
+		}
+
 		// Start server in separate thread
 		bool StartServer(const sf::IpAddress& address, Port port)
 		{
-			gServerThread = std::thread([&] { ServerTask(address, port); });
+			// The thread outlives the arguments, so it gets copies of them
+			gServerThread = std::thread([=] { ServerTask(address, port); });
 
 			return true;
 		}
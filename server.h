@@ -1,7 +1,9 @@
 #pragma once
 #include "network.h"
+#include "handoff.h"
 #include <atomic>
 #include <condition_variable>
+#include <vector>
 
 namespace Network
 {
@@ -10,5 +12,35 @@ namespace Network
 		bool StartServer(const sf::IpAddress& address, Port port);
 		void ServerTask(const sf::IpAddress& address, Port port);
 		void CloseServer();
+
+		// Settings, which must be made before the server starts
+
+		// The secret relays join with; relays are turned away while it is empty
+		void SetRelayKey(const std::string& key);
+		// Record the match to 'path'; a server that takes over records to a new file next to it
+		void SetRecordingPath(const std::string& path);
+		// Hand the game over to a new server process on SIGUSR2
+		void EnableHotRestart(const std::string& socketPath = Handoff::DEFAULT_SOCKET_PATH,
+							  const std::string& checkpointPath = Handoff::DEFAULT_CHECKPOINT_PATH);
+		// Take over from a running server, rather than starting a new game
+		void SetResuming(bool resume);
+		void SetBackpressurePolicy(const BackpressurePolicy& policy);
+		void EnableStats();
+
+		// What the server is holding on to, and how long its ticks take
+		struct Stats
+		{
+			std::size_t connections = 0;
+			std::size_t players = 0;
+			std::size_t bullets = 0;
+			std::size_t snapshots = 0;			// Kept for rewinding shots
+			std::size_t backlogSnapshots = 0;	// Kept for spectators that have just joined
+			std::size_t pendingBytes = 0;		// Queued for every connection, waiting for their sockets
+			LatencyHistogram tickTime;			// How long each tick took, not counting the wait for packets
+			LatencyHistogram inputLatency;		// From when clients input commands to when we ran them, every client together
+		};
+
+		// The Stats since the last call (safe to call from another thread)
+		Stats TakeStats();
 	}
 }
\ No newline at end of file
@@ -0,0 +1,88 @@
+#include "server.h"
+#include <cstring>
+#include "debug.h"
+using namespace Network;
+
+// Usage: networking-server [--address <ip>] [--port <port>] [--record <path>] [--relay-key <secret>]
+//							[--resume] [--handoff <socket path>] [--checkpoint <path>]
+// A dedicated server, without a window; it does not need SFML's graphics or window modules
+
+constexpr char DEFAULT_IP[] = "0.0.0.0";
+constexpr Port DEFAULT_PORT = 11223;
+
+int Usage(const char* name)
+{
+	debug << "Usage: " << name << " [--address <ip>] [--port <port>] [--record <path>] [--relay-key <secret>]\n" <<
+			 "       " << std::string(std::strlen(name), ' ') << " [--resume] [--handoff <socket path>] [--checkpoint <path>]\n" <<
+			 "  --address     Address to listen on (default " << DEFAULT_IP << ")\n" <<
+			 "  --port        Port to listen on (default " << DEFAULT_PORT << ")\n" <<
+			 "  --record      Record the match to a file (see recording.h); with --resume, to a new file named after it\n" <<
+			 "  --relay-key   Secret relays have to give to join (no relays are let in without one)\n" <<
+			 "  --resume      Take over from a running server instead of starting a new game (see handoff.h)\n" <<
+			 "  --handoff     Socket the old and new server meet at (default " << Handoff::DEFAULT_SOCKET_PATH << ")\n" <<
+			 "  --checkpoint  File the game is handed over in (default " << Handoff::DEFAULT_CHECKPOINT_PATH << ")" << std::endl;
+	return 1;
+}
+
+int main(int argc, const char* argv[])
+{
+	std::string address = DEFAULT_IP;
+	Port port = DEFAULT_PORT;
+	std::string recordingPath;
+	std::string relayKey;
+	std::string handoffPath = Handoff::DEFAULT_SOCKET_PATH;
+	std::string checkpointPath = Handoff::DEFAULT_CHECKPOINT_PATH;
+	bool isResuming = false;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+		// Every option but --resume takes a value
+		const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+
+		if (std::strcmp(arg, "--resume") == 0)
+		{
+			isResuming = true;
+			continue;
+		}
+
+		if (!value)
+			return Usage(argv[0]);
+
+		if (std::strcmp(arg, "--address") == 0)
+			address = value;
+		else if (std::strcmp(arg, "--port") == 0)
+			port = atoi(value);
+		else if (std::strcmp(arg, "--record") == 0)
+			recordingPath = value;
+		else if (std::strcmp(arg, "--relay-key") == 0)
+			relayKey = value;
+		else if (std::strcmp(arg, "--handoff") == 0)
+			handoffPath = value;
+		else if (std::strcmp(arg, "--checkpoint") == 0)
+			checkpointPath = value;
+		else
+			return Usage(argv[0]);
+
+		++i;
+	}
+
+	if (!recordingPath.empty())
+		Server::SetRecordingPath(recordingPath);
+
+	Server::SetRelayKey(relayKey);
+
+	// Dedicated servers can be replaced without dropping anyone
+	Server::EnableHotRestart(handoffPath, checkpointPath);
+	Server::SetResuming(isResuming);
+
+	if (isResuming)
+		debug << "Taking over from the running server" << std::endl;
+	else
+		debug << "Using address: " << address << ':' << port << std::endl;
+
+	// Runs until the server is handed over (or fails to start)
+	Server::ServerTask({ address }, port);
+
+	return 0;
+}
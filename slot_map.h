@@ -0,0 +1,287 @@
+#pragma once
+#include <SFML/System.hpp>
+#include <memory>
+#include <vector>
+#include "cow_vector.h"
+
+// slot_map.h: Entities stored densely, and found by id in O(1) through a table of slots
+//			   An id is a slot index (low 16 bits) and the slot's generation (high 16 bits), which moves on when it is freed
+//			   T needs GetID() and SetID(EntityID)
+// NOTE: Entities that already have an id (e.g. received from the server) take their slot over from whatever
+//		 holds it. The entity they replace can still be iterated over, but is no longer found by id
+
+using EntityID = sf::Uint32;
+
+// Slot 0 is never handed out, so no valid id is 0
+constexpr EntityID INVALID_ENTITY = 0;
+
+inline sf::Uint16 EntityIndex(EntityID id) { return sf::Uint16(id & 0xFFFF); }
+inline sf::Uint16 EntityGeneration(EntityID id) { return sf::Uint16(id >> 16); }
+inline EntityID MakeEntityID(sf::Uint16 index, sf::Uint16 generation) { return (EntityID(generation) << 16) | index; }
+
+template <typename T>
+class slot_map
+{
+public:
+	using const_iterator = typename cow_vector<T>::const_iterator;
+
+	std::size_t size() const { return mElements.size(); }
+	bool empty() const { return mElements.empty(); }
+
+	const_iterator begin() const { return mElements.begin(); }
+	const_iterator end() const { return mElements.end(); }
+
+	const T& operator[](std::size_t i) const { return mElements[i]; }
+
+	const cow_vector<T>& elements() const { return mElements; }
+
+	// Moves on whenever the entities are replaced all at once (assign, clear, decoding)
+	sf::Uint32 assignments() const { return mAssignments; }
+
+	// Position of the entity with this id, or -1
+	int find(EntityID id) const
+	{
+		sf::Uint16 index = EntityIndex(id);
+		if (!mTable || index == 0 || index >= mTable->slots.size())
+			return -1;
+
+		std::size_t position = mTable->slots[index].position;
+		if (position == NO_POSITION || mElements[position].GetID() != id)
+			return -1;
+
+		return int(position);
+	}
+
+	// Writable reference to the entity at position i (its id must not be changed)
+	T& mutate(std::size_t i) { return mElements.mutate(i); }
+
+	// Gives 'value' a new id and adds it
+	// Returns nullptr if every slot is taken
+	T* insert(const T& value)
+	{
+		EntityID id = Allocate();
+		if (id == INVALID_ENTITY)
+			return nullptr;
+
+		T& element = mElements.push_back(value);
+		element.SetID(id);
+		Claim(id, mElements.size() - 1);
+		return &element;
+	}
+
+	// Adds an entity that already has an id
+	T& insert_existing(const T& value)
+	{
+		T& element = mElements.push_back(value);
+		Claim(element.GetID(), mElements.size() - 1);
+		return element;
+	}
+
+	// Adds entity i of another slot_map, keeping its id, without duplicating it
+	void push_back_shared(const slot_map& other, std::size_t i)
+	{
+		mElements.push_back_shared(other.mElements, i);
+		Claim(other[i].GetID(), mElements.size() - 1);
+	}
+
+	bool erase(EntityID id)
+	{
+		int position = find(id);
+		if (position < 0)
+			return false;
+
+		EraseAt(position);
+		return true;
+	}
+
+	// Removes every entity matching pred, returns how many were removed
+	template <typename Pred>
+	std::size_t remove_if(Pred pred)
+	{
+		std::size_t removed = 0;
+		for (std::size_t i = 0; i < mElements.size(); )
+		{
+			// The entity moved into position i is checked next
+			if (pred(mElements[i]))
+			{
+				EraseAt(i);
+				++removed;
+			}
+			else
+				++i;
+		}
+
+		return removed;
+	}
+
+	// Replaces every entity with ones that already have ids
+	void assign(const cow_vector<T>& elements)
+	{
+		mElements = elements;
+		mTable.reset();
+		++mAssignments;
+
+		for (std::size_t i = 0; i < mElements.size(); ++i)
+			Claim(mElements[i].GetID(), i);
+	}
+
+	void clear()
+	{
+		mElements.clear();
+		mTable.reset();
+		++mAssignments;
+	}
+
+	void reserve(std::size_t n) { mElements.reserve(n); }
+
+	// Every slot's generation, which assign() alone forgets for free slots
+	std::vector<sf::Uint16> generations() const
+	{
+		std::vector<sf::Uint16> generations;
+		if (mTable)
+		{
+			generations.reserve(mTable->slots.size());
+			for (const Slot& slot : mTable->slots)
+				generations.push_back(slot.generation);
+		}
+
+		return generations;
+	}
+
+	void restore_generations(const std::vector<sf::Uint16>& generations)
+	{
+		if (generations.size() > MAX_SLOTS)
+			return;
+
+		Table& table = OwnTable();
+		for (std::size_t i = 1; i < generations.size(); ++i)
+		{
+			if (i >= table.slots.size())
+			{
+				table.free.push_back(sf::Uint16(i));
+				table.slots.emplace_back();
+				table.slots.back().isFreeListed = true;
+			}
+
+			// Slots in use already have their entity's generation
+			if (table.slots[i].position == NO_POSITION)
+				table.slots[i].generation = generations[i];
+		}
+	}
+
+private:
+	static constexpr sf::Uint32 NO_POSITION = ~sf::Uint32(0);
+	static constexpr std::size_t MAX_SLOTS = std::size_t(1) << 16;
+
+	struct Slot
+	{
+		sf::Uint16 generation = 0;
+		bool isFreeListed = false;
+		sf::Uint32 position = NO_POSITION;
+	};
+
+	struct Table
+	{
+		std::vector<Slot> slots;
+		// Slots that may be free (a slot taken over by an entity that already had an id is left here, and skipped)
+		std::vector<sf::Uint16> free;
+	};
+
+	// Make sure no copy shares our slot table before we modify it
+	Table& OwnTable()
+	{
+		if (!mTable)
+			mTable = std::make_shared<Table>();
+		else if (mTable.use_count() > 1)
+			mTable = std::make_shared<Table>(*mTable);
+
+		// Slot 0 stands for INVALID_ENTITY
+		if (mTable->slots.empty())
+			mTable->slots.emplace_back();
+
+		return *mTable;
+	}
+
+	EntityID Allocate()
+	{
+		Table& table = OwnTable();
+
+		while (!table.free.empty())
+		{
+			sf::Uint16 index = table.free.back();
+			table.free.pop_back();
+
+			Slot& slot = table.slots[index];
+			slot.isFreeListed = false;
+			if (slot.position == NO_POSITION)
+				return MakeEntityID(index, slot.generation);
+		}
+
+		if (table.slots.size() >= MAX_SLOTS)
+			return INVALID_ENTITY;
+
+		table.slots.emplace_back();
+		return MakeEntityID(sf::Uint16(table.slots.size() - 1), 0);
+	}
+
+	void Claim(EntityID id, std::size_t position)
+	{
+		sf::Uint16 index = EntityIndex(id);
+		if (index == 0)
+			return;
+
+		Table& table = OwnTable();
+
+		// Slots skipped over can be handed out later
+		while (table.slots.size() <= index)
+		{
+			table.free.push_back(sf::Uint16(table.slots.size()));
+			table.slots.emplace_back();
+			table.slots.back().isFreeListed = true;
+		}
+
+		Slot& slot = table.slots[index];
+		slot.generation = EntityGeneration(id);
+		slot.position = sf::Uint32(position);
+	}
+
+	void EraseAt(std::size_t position)
+	{
+		Table& table = OwnTable();
+		std::size_t last = mElements.size() - 1;
+
+		// Free the slot, unless another entity has taken it over
+		Slot* slot = GetSlot(table, mElements[position].GetID());
+		if (slot && slot->position == position)
+		{
+			slot->position = NO_POSITION;
+			++slot->generation;
+
+			if (!slot->isFreeListed)
+			{
+				slot->isFreeListed = true;
+				table.free.push_back(EntityIndex(mElements[position].GetID()));
+			}
+		}
+
+		// The last entity moves into the gap
+		if (position != last)
+		{
+			Slot* moved = GetSlot(table, mElements[last].GetID());
+			if (moved && moved->position == last)
+				moved->position = sf::Uint32(position);
+		}
+
+		mElements.swap_erase(position);
+	}
+
+	static Slot* GetSlot(Table& table, EntityID id)
+	{
+		sf::Uint16 index = EntityIndex(id);
+		return (index != 0 && index < table.slots.size()) ? &table.slots[index] : nullptr;
+	}
+
+	cow_vector<T> mElements;
+	std::shared_ptr<Table> mTable;
+	sf::Uint32 mAssignments = 0;
+};
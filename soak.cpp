@@ -0,0 +1,541 @@
+#include "soak.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <thread>
+#ifdef __linux__
+#include <unistd.h>
+#endif
+#include "messages.h"
+#include "server.h"
+#include "debug.h"
+
+namespace Network
+{
+	namespace Soak
+	{
+		// Global Variables //////
+
+		// How often the scripted clients run, and send a movement command
+		constexpr int FRAME_TIME_MS = 16;
+
+		// How often a playing client fires, on average
+		constexpr int SHOOT_INTERVAL_MS = 500;
+
+		// How often a client changes direction, on average
+		constexpr int TURN_INTERVAL_MS = 1000;
+
+		// Samples taken before this much of the run has gone are left out of the trends, while things warm up
+		constexpr float WARM_UP_FRACTION = 0.1f;
+
+		// Too few samples to tell a trend from noise
+		constexpr std::size_t MIN_TREND_SAMPLES = 4;
+
+		// How well a straight line has to fit the samples for their slope to count as a trend (coefficient of determination)
+		constexpr double MIN_TREND_FIT = 0.5;
+
+		time_point gStartTime;
+		std::mt19937 gRandom{ std::random_device{}() };
+
+		sf::Uint64 GetClockTime()
+		{
+			return to_us(gStartTime, the_clock::now()).count();
+		}
+
+		bool Chance(ms dt, int intervalMs)
+		{
+			return std::uniform_int_distribution<int>(0, intervalMs - 1)(gRandom) < dt.count();
+		}
+
+		// CLIENTS /////////////////////////////////////////
+
+		// A headless client that plays (or spectates, once the game is full) until its time is up
+		// It does just enough for the server to treat it like any other client: it acknowledges updates, answers pings,
+		// moves and shoots. The capabilities it asks for are picked at random, so old and new clients are both covered
+		class Client
+		{
+		public:
+			Client(time_point now, ms lifetime) : mLeavePoint(now + lifetime), mLastCommandPoint(now) {}
+
+			bool Connect(Port port)
+			{
+				if (!mConnection.Connect(sf::IpAddress::LocalHost, port))
+					return false;
+
+				mConnection.SetBlocking(false);
+
+				Message<PACKET_CLIENT_JOIN> join;
+				switch (std::uniform_int_distribution<int>(0, 2)(gRandom))
+				{
+					case 0:
+						break;
+					case 1:
+						join.capabilities = sf::Uint8(CAPABILITY_COMPRESSION_V2);
+						break;
+					default:
+						join.capabilities = sf::Uint8(CAPABILITY_COMPRESSION_V2 | CAPABILITY_SPAWN_TOKENS | CAPABILITY_CHECKSUMS);
+						break;
+				}
+
+				mConnection.Send(join);
+				mConnection.status = STATUS_JOINING;
+				return true;
+			}
+
+			// Returns false once the client is done, or has lost its connection
+			bool Update(time_point now)
+			{
+				if (!Receive() || !mConnection.active)
+					return false;
+
+				if (mConnection.status == STATUS_PLAYING)
+					Play(now);
+
+				return now < mLeavePoint;
+			}
+
+			void Disconnect()
+			{
+				mConnection.Disconnect();
+			}
+
+		private:
+			bool Receive()
+			{
+				const sf::Uint8* data;
+				std::size_t size;
+				while (mConnection.Receive(data, size))
+				{
+					if (size == 0)
+						continue;
+
+					if (data[0] == PACKET_SERVER_COMPRESSED)
+					{
+						sf::Packet inner;
+						if (!DecompressPacket(data + 1, size - 1, inner) || !Handle(static_cast<const sf::Uint8*>(inner.getData()), inner.getDataSize()))
+							return false;
+					}
+					else if (!Handle(data, size))
+						return false;
+				}
+
+				return true;
+			}
+
+			bool Handle(const sf::Uint8* data, std::size_t size)
+			{
+				switch (data[0])
+				{
+					case PACKET_SERVER_WELCOME:
+					{
+						Message<PACKET_SERVER_WELCOME> welcome;
+						if (!Decode(data + 1, size - 1, welcome))
+							return false;
+
+						mConnection.pid = welcome.pid;
+						mConnection.capabilities = welcome.capabilities;
+						mConnection.status = STATUS_PLAYING;
+					}
+					break;
+
+					case PACKET_SERVER_SPECTATOR:
+					{
+						Message<PACKET_SERVER_SPECTATOR> spectator;
+						if (!Decode(data + 1, size - 1, spectator))
+							return false;
+
+						mConnection.capabilities = spectator.capabilities;
+						mConnection.status = STATUS_SPECTATING;
+					}
+					break;
+
+					case PACKET_SERVER_FULL:
+						return false;
+
+					case PACKET_SERVER_UPDATE:
+					{
+						Message<PACKET_SERVER_UPDATE> update;
+						if (!Decode(data + 1, size - 1, update))
+							return false;
+
+						mServerTime = update.snapshot.serverTime;
+
+						Message<PACKET_CLIENT_ACK> ack;
+						ack.serverTime = mServerTime;
+						mConnection.Send(ack);
+					}
+					break;
+
+					case PACKET_SERVER_PING:
+					{
+						Message<PACKET_SERVER_PING> ping;
+						if (!Decode(data + 1, size - 1, ping))
+							return false;
+
+						Message<PACKET_CLIENT_PING> response;
+						response.serverTime = ping.serverTime;
+						response.clientTime = GetClockTime();
+						mConnection.Send(response);
+					}
+					break;
+				}
+
+				return true;
+			}
+
+			void Play(time_point now)
+			{
+				ms dt = to_ms(mLastCommandPoint, now);
+				if (dt.count() < FRAME_TIME_MS)
+					return;
+
+				mLastCommandPoint = now;
+
+				if (Chance(dt, TURN_INTERVAL_MS))
+					mDirection = Command::Direction(std::uniform_int_distribution<int>(Command::IDLE, Command::RIGHT)(gRandom));
+
+				Message<PACKET_CLIENT_CMD> cmd;
+				cmd.cmd.id = mNextCommandID++;
+				cmd.cmd.direction = mDirection;
+				cmd.cmd.dt = dt.count();
+				mConnection.Send(cmd);
+
+				// The newest update's time is close enough to the server's clock for the server to find the snapshot
+				if (Chance(dt, SHOOT_INTERVAL_MS) && mServerTime > 0)
+				{
+					Message<PACKET_CLIENT_SHOOT> shoot;
+					shoot.serverTime = mServerTime;
+					if (mConnection.Accepts(CAPABILITY_SPAWN_TOKENS))
+						shoot.spawnToken = mNextSpawnToken++;
+
+					mConnection.Send(shoot);
+				}
+			}
+
+			Connection mConnection;
+			time_point mLeavePoint;
+			time_point mLastCommandPoint;
+			Command::Direction mDirection = Command::IDLE;
+			sf::Uint32 mNextCommandID = 0;
+			sf::Uint32 mNextSpawnToken = 0;
+			sf::Uint64 mServerTime = 0;
+		};
+
+		// SAMPLES /////////////////////////////////////////
+
+		struct Sample
+		{
+			double time = 0.;				// Seconds since the start of the run
+			double rssKb = 0.;
+			double liveAllocations = 0.;
+			double allocationsPerSecond = 0.;
+			double connections = 0.;
+			double players = 0.;
+			double bullets = 0.;
+			double snapshots = 0.;
+			double backlogSnapshots = 0.;
+			double pendingBytes = 0.;
+			double ticks = 0.;
+			double tickP50Us = 0.;
+			double tickP99Us = 0.;
+			double tickMaxUs = 0.;
+		};
+
+		// What is watched for trends; the floor keeps a metric that sits near zero (bullets, say) from being
+		// flagged for growing by a large fraction of very little
+		struct Metric
+		{
+			const char* name;
+			double Sample::* value;
+			double floor;
+			bool isMeasured;
+		};
+
+		std::vector<Metric> GetMetrics(const Options& options)
+		{
+			bool hasAllocations = options.totalAllocations && options.liveAllocations;
+#ifdef __linux__
+			bool hasRss = true;
+#else
+			bool hasRss = false;
+#endif
+
+			return {
+				{ "rss_kb", &Sample::rssKb, 4096., hasRss },
+				{ "live_allocations", &Sample::liveAllocations, 1000., hasAllocations },
+				{ "allocations_per_s", &Sample::allocationsPerSecond, 1000., hasAllocations },
+				{ "connections", &Sample::connections, 4., true },
+				{ "players", &Sample::players, 2., true },
+				{ "bullets", &Sample::bullets, 10., true },
+				{ "snapshots", &Sample::snapshots, 50., true },
+				{ "backlog_snapshots", &Sample::backlogSnapshots, 20., true },
+				{ "pending_bytes", &Sample::pendingBytes, 65536., true },
+				{ "tick_p50_us", &Sample::tickP50Us, 100., true },
+				{ "tick_p99_us", &Sample::tickP99Us, 500., true },
+				{ "tick_max_us", &Sample::tickMaxUs, 5000., true },
+			};
+		}
+
+		// Resident set size of the whole process (the server and the clients), in kilobytes; 0 where it cannot be read
+		double GetRssKb()
+		{
+#ifdef __linux__
+			std::FILE* file = std::fopen("/proc/self/statm", "r");
+			if (!file)
+				return 0.;
+
+			unsigned long size = 0, resident = 0;
+			int read = std::fscanf(file, "%lu %lu", &size, &resident);
+			std::fclose(file);
+
+			return (read == 2) ? double(resident) * sysconf(_SC_PAGESIZE) / 1024. : 0.;
+#else
+			return 0.;
+#endif
+		}
+
+		Sample TakeSample(const Options& options, double seconds, double intervalSeconds, sf::Uint64& lastTotalAllocations)
+		{
+			Server::Stats stats = Server::TakeStats();
+
+			Sample sample;
+			sample.time = seconds;
+			sample.rssKb = GetRssKb();
+
+			if (options.totalAllocations && options.liveAllocations)
+			{
+				sf::Uint64 total = options.totalAllocations();
+				sample.liveAllocations = double(options.liveAllocations());
+				sample.allocationsPerSecond = (intervalSeconds > 0.) ? double(total - lastTotalAllocations) / intervalSeconds : 0.;
+				lastTotalAllocations = total;
+			}
+
+			sample.connections = double(stats.connections);
+			sample.players = double(stats.players);
+			sample.bullets = double(stats.bullets);
+			sample.snapshots = double(stats.snapshots);
+			sample.backlogSnapshots = double(stats.backlogSnapshots);
+			sample.pendingBytes = double(stats.pendingBytes);
+			sample.ticks = double(stats.tickTime.GetCount());
+			sample.tickP50Us = double(stats.tickTime.GetPercentile(0.5));
+			sample.tickP99Us = double(stats.tickTime.GetPercentile(0.99));
+			sample.tickMaxUs = double(stats.tickTime.GetMax());
+
+			return sample;
+		}
+
+		// REPORT //////////////////////////////////////////
+
+		void WriteCsvHeader(std::ostream& out, const std::vector<Metric>& metrics)
+		{
+			out << "time_s,ticks";
+			for (const Metric& metric : metrics)
+				out << ',' << metric.name;
+			out << '\n';
+		}
+
+		void WriteCsvRow(std::ostream& out, const Sample& sample, const std::vector<Metric>& metrics)
+		{
+			out << sample.time << ',' << sample.ticks;
+			for (const Metric& metric : metrics)
+				out << ',' << sample.*metric.value;
+			out << std::endl;
+		}
+
+		struct Trend
+		{
+			double start;	// Where the fitted line starts, and ends
+			double end;
+			double fit;		// Coefficient of determination
+		};
+
+		// Least squares line through the samples taken after warming up
+		bool FitTrend(const std::vector<Sample>& samples, double Sample::* value, Trend& trend)
+		{
+			double warmUp = samples.back().time * WARM_UP_FRACTION;
+			std::vector<const Sample*> used;
+			for (const Sample& sample : samples)
+			{
+				if (sample.time >= warmUp)
+					used.push_back(&sample);
+			}
+
+			if (used.size() < MIN_TREND_SAMPLES)
+				return false;
+
+			double n = double(used.size());
+			double meanT = 0., meanV = 0.;
+			for (const Sample* sample : used)
+			{
+				meanT += sample->time / n;
+				meanV += sample->*value / n;
+			}
+
+			double stt = 0., stv = 0., svv = 0.;
+			for (const Sample* sample : used)
+			{
+				double dt = sample->time - meanT;
+				double dv = sample->*value - meanV;
+				stt += dt * dt;
+				stv += dt * dv;
+				svv += dv * dv;
+			}
+
+			if (stt <= 0.)
+				return false;
+
+			double slope = stv / stt;
+			trend.start = meanV + slope * (used.front()->time - meanT);
+			trend.end = meanV + slope * (used.back()->time - meanT);
+			trend.fit = (svv > 0.) ? (stv * stv) / (stt * svv) : 0.;
+			return true;
+		}
+
+		// Returns the number of metrics flagged
+		int Report(const std::vector<Sample>& samples, const std::vector<Metric>& metrics, const Options& options)
+		{
+			int flagged = 0;
+
+			debug << "SOAK: Trends over " << samples.size() << " samples (after the first " << int(WARM_UP_FRACTION * 100.f) << "% of the run):" << std::endl;
+
+			for (const Metric& metric : metrics)
+			{
+				if (!metric.isMeasured)
+					continue;
+
+				Trend trend;
+				if (samples.empty() || !FitTrend(samples, metric.value, trend))
+				{
+					debug << "SOAK:   " << metric.name << ": not enough samples" << std::endl;
+					continue;
+				}
+
+				double growth = (trend.end - trend.start) / std::max(std::abs(trend.start), metric.floor);
+				bool isFlagged = growth > options.growthThreshold && trend.fit >= MIN_TREND_FIT;
+				if (isFlagged)
+					++flagged;
+
+				char line[160];
+				std::snprintf(line, sizeof(line), "%-18s %12.1f -> %12.1f  (%+6.1f%%, fit %.2f)%s",
+					metric.name, trend.start, trend.end, growth * 100., trend.fit, isFlagged ? "  <-- GROWING" : "");
+				debug << "SOAK:   " << line << std::endl;
+			}
+
+			if (flagged > 0)
+				debug << "SOAK: " << flagged << " metric(s) kept growing" << std::endl;
+			else
+				debug << "SOAK: Nothing kept growing" << std::endl;
+
+			return flagged;
+		}
+
+		// RUN /////////////////////////////////////////////
+
+		bool RunSoak(const Options& options)
+		{
+			gStartTime = the_clock::now();
+
+			std::vector<Metric> metrics = GetMetrics(options);
+
+			std::ofstream csv;
+			if (!options.csvPath.empty())
+			{
+				csv.open(options.csvPath);
+				if (!csv)
+				{
+					debug << "SOAK: Could not open " << options.csvPath << std::endl;
+					return false;
+				}
+
+				WriteCsvHeader(csv, metrics);
+			}
+
+			Server::EnableStats();
+			Server::StartServer(sf::IpAddress::LocalHost, options.port);
+
+			std::vector<std::unique_ptr<Client>> clients;
+			std::vector<Sample> samples;
+			sf::Uint64 joined = 0, left = 0, failed = 0;
+			sf::Uint64 lastTotalAllocations = options.totalAllocations ? options.totalAllocations() : 0;
+
+			time_point endPoint = gStartTime + options.duration;
+			time_point lastSamplePoint = gStartTime;
+			time_point nextSamplePoint = gStartTime + options.sampleInterval;
+
+			debug << "SOAK: Running for " << options.duration.count() << "s with " << options.clients << " clients, sampling every " <<
+				options.sampleInterval.count() << 's' << std::endl;
+
+			std::uniform_int_distribution<ms::rep> lifetime(options.minLifetime.count(), std::max(options.minLifetime, options.maxLifetime).count());
+
+			time_point now = the_clock::now();
+			while (now < endPoint)
+			{
+				// Keep the numbers up; the server takes a moment to start listening, so the first few may not get in
+				while (int(clients.size()) < options.clients)
+				{
+					auto client = std::make_unique<Client>(now, ms(lifetime(gRandom)));
+					if (!client->Connect(options.port))
+					{
+						++failed;
+						break;
+					}
+
+					clients.push_back(std::move(client));
+					++joined;
+				}
+
+				for (auto it = clients.begin(); it != clients.end(); )
+				{
+					if ((*it)->Update(now))
+					{
+						++it;
+						continue;
+					}
+
+					(*it)->Disconnect();
+					it = clients.erase(it);
+					++left;
+				}
+
+				if (now >= nextSamplePoint)
+				{
+					double seconds = std::chrono::duration<double>(now - gStartTime).count();
+					double interval = std::chrono::duration<double>(now - lastSamplePoint).count();
+
+					Sample sample = TakeSample(options, seconds, interval, lastTotalAllocations);
+					samples.push_back(sample);
+
+					debug << "SOAK: " << int(seconds) << "s  rss " << int(sample.rssKb) << "KB  live allocations " << sf::Uint64(sample.liveAllocations) <<
+						"  connections " << sample.connections << "  bullets " << sample.bullets << "  snapshots " << sample.snapshots <<
+						"  tick p50/p99/max " << sample.tickP50Us << '/' << sample.tickP99Us << '/' << sample.tickMaxUs << "us" <<
+						"  (" << joined << " joined, " << left << " left, " << failed << " failed to connect)" << std::endl;
+
+					if (csv)
+						WriteCsvRow(csv, sample, metrics);
+
+					lastSamplePoint = now;
+					nextSamplePoint = now + options.sampleInterval;
+				}
+
+				std::this_thread::sleep_for(ms(FRAME_TIME_MS));
+				now = the_clock::now();
+			}
+
+			for (auto& client : clients)
+				client->Disconnect();
+
+			Server::CloseServer();
+
+			if (joined == 0)
+			{
+				debug << "SOAK: No client could connect to the server" << std::endl;
+				return false;
+			}
+
+			return Report(samples, metrics, options) == 0;
+		}
+	}
+}
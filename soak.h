@@ -0,0 +1,38 @@
+#pragma once
+#include <string>
+#include "network.h"
+
+// soak.h: Runs the server with scripted clients for hours, and flags memory, containers or tick times that keep growing
+
+namespace Network
+{
+	namespace Soak
+	{
+		struct Options
+		{
+			Port port = 11230;
+			std::chrono::seconds duration{ 4 * 60 * 60 };
+			std::chrono::seconds sampleInterval{ 30 };
+
+			// Clients connected at any one time; each stays for a random time in [minLifetime, maxLifetime] and is then replaced
+			int clients = 8;
+			ms minLifetime{ 5000 };
+			ms maxLifetime{ 60000 };
+
+			// Also write every sample to this file, as CSV
+			std::string csvPath;
+
+			// Heap allocations made so far, and those not freed yet; counted by whoever replaces operator new
+			// (nullptr if nobody does, in which case they are left out)
+			sf::Uint64(*totalAllocations)() = nullptr;
+			sf::Uint64(*liveAllocations)() = nullptr;
+
+			// How much a metric may grow over the run (after warming up), relative to where it started, before it is flagged
+			float growthThreshold = 0.2f;
+		};
+
+		// Runs for options.duration
+		// Returns false if no client could connect to the server, or something kept growing
+		bool RunSoak(const Options& options);
+	}
+}
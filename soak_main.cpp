@@ -0,0 +1,92 @@
+#include "soak.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include "debug.h"
+using namespace Network;
+
+// Usage: networking-soak [--duration <seconds>] [--interval <seconds>] [--clients <n>] [--port <port>] [--csv <path>]
+// Runs the server with scripted clients for a long time, and reports anything that keeps growing (see soak.h)
+
+// Every heap allocation in the process (the server's and the clients') goes through these, so they can be counted
+namespace
+{
+	std::atomic<sf::Uint64> gTotalAllocations{ 0 };
+	std::atomic<sf::Uint64> gLiveAllocations{ 0 };
+
+	void* Allocate(std::size_t size)
+	{
+		void* p = std::malloc(size ? size : 1);
+		if (!p)
+			throw std::bad_alloc();
+
+		++gTotalAllocations;
+		++gLiveAllocations;
+		return p;
+	}
+
+	void Free(void* p)
+	{
+		if (!p)
+			return;
+
+		--gLiveAllocations;
+		std::free(p);
+	}
+
+	sf::Uint64 GetTotalAllocations() { return gTotalAllocations; }
+	sf::Uint64 GetLiveAllocations() { return gLiveAllocations; }
+}
+
+void* operator new(std::size_t size) { return Allocate(size); }
+void* operator new[](std::size_t size) { return Allocate(size); }
+void operator delete(void* p) noexcept { Free(p); }
+void operator delete[](void* p) noexcept { Free(p); }
+void operator delete(void* p, std::size_t) noexcept { Free(p); }
+void operator delete[](void* p, std::size_t) noexcept { Free(p); }
+
+int Usage(const char* name)
+{
+	Soak::Options defaults;
+	debug << "Usage: " << name << " [--duration <seconds>] [--interval <seconds>] [--clients <n>] [--port <port>] [--csv <path>]\n" <<
+			 "  --duration  How long to run for (default " << defaults.duration.count() << ")\n" <<
+			 "  --interval  Time between samples (default " << defaults.sampleInterval.count() << ")\n" <<
+			 "  --clients   Clients connected at once, each replaced when it leaves (default " << defaults.clients << ")\n" <<
+			 "  --port      Port the server listens on (default " << defaults.port << ")\n" <<
+			 "  --csv       Also write every sample to a file" << std::endl;
+	return 1;
+}
+
+int main(int argc, const char* argv[])
+{
+	Soak::Options options;
+	options.totalAllocations = GetTotalAllocations;
+	options.liveAllocations = GetLiveAllocations;
+
+	// Every option takes a value
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		const char* arg = argv[i];
+		const char* value = argv[i + 1];
+
+		if (std::strcmp(arg, "--duration") == 0)
+			options.duration = std::chrono::seconds(atoi(value));
+		else if (std::strcmp(arg, "--interval") == 0)
+			options.sampleInterval = std::chrono::seconds(std::max(1, atoi(value)));
+		else if (std::strcmp(arg, "--clients") == 0)
+			options.clients = atoi(value);
+		else if (std::strcmp(arg, "--port") == 0)
+			options.port = atoi(value);
+		else if (std::strcmp(arg, "--csv") == 0)
+			options.csvPath = value;
+		else
+			return Usage(argv[0]);
+	}
+
+	if (argc % 2 == 0)
+		return Usage(argv[0]);
+
+	return Soak::RunSoak(options) ? 0 : 1;
+}
@@ -1,49 +1,32 @@
 #include "world.h"
 #include "common.h"
-#include "network.h"
 #include "debug.h"
 #include <algorithm>
 
-/* static */ const sf::Vector2f World::INVALID_POS = { -1.f, -1.f };
+/* static */ const Vector World::INVALID_POS = ToVector({ -1.f, -1.f });
 
-/* static */ void World::RenderWorld(const World & world, sf::RenderWindow & window, bool showServerBullets)
+void World::AddBullet(const Bullet & bullet)
 {
-	sf::RectangleShape shape({ PADDLE_W, PADDLE_H });
-	shape.setOrigin({ H_PADDLE_W, H_PADDLE_H });
-
-	for (const auto& player : world.mPlayers)
-	{
-		shape.setFillColor(sf::Color(player.GetColour()));
-		shape.setPosition(player.GetPosition());
-		window.draw(shape);
-	}
+	mBulletChecksum.Add(mBullets, mBullets.insert_existing(bullet));
+}
 
-	// NOTE: Objects should really just store their own size, or have their own renderable shapes
-	shape.setSize({ BULLET_W, BULLET_H });
-	shape.setOrigin({ H_BULLET_W, H_BULLET_H });
-	for (const auto& bullet : world.mBullets)
-	{
-		shape.setFillColor(sf::Color(bullet.GetColour()));
-		shape.setPosition(bullet.GetPosition());
-		window.draw(shape);
-	}
+void World::RemoveBullet(EntityID id)
+{
+	int index = mBullets.find(id);
+	if (index < 0)
+		return;
 
-	if (showServerBullets)
-	{
-		shape.setFillColor(sf::Color(0x00000000));
-		shape.setOutlineThickness(1.f);
-		for (const auto& bullet : world.mServerBullets)
-		{
-			shape.setOutlineColor(sf::Color(0xA0A0FFFF));
-			shape.setPosition(bullet.GetPosition());
-			window.draw(shape);
-		}
-	}
+	mBulletChecksum.Remove(mBullets, mBullets[index]);
+	mBullets.erase(id);
 }
 
-void World::AddBullet(const Bullet & bullet)
+void World::AddServerBullet(const Bullet& bullet)
 {
-	mBullets.push_back(bullet);
+	if (mServerBullets.find(bullet.GetID()) >= 0)
+		return;
+
+	mServerBulletChecksum.Add(mServerBullets, mServerBullets.insert_existing(bullet));
+	mDepartedServerBullets.erase(bullet.GetID());
 }
 
 // Try to add a new player to the game
@@ -52,40 +35,121 @@ bool World::AddPlayer(Player& player)
 	if (mPlayers.size() >= MAX_PLAYERS)
 		return false;
 
-	sf::Uint8 newPID = GeneratePlayerID();
+	// Determine spawn position
+	Scalar lane = LANE_TOP;
+	if (IsLaneOccupied(lane))
+		lane = LANE_BOTTOM;
+
+	Player* newPlayer = mPlayers.insert(player);
 
-	if (!newPID)
+	if (!newPlayer)
 		return false;
 
-	player.SetPID(newPID);
+	newPlayer->SetPosition({ SPAWN_POS_X, lane });
+	player.SetID(newPlayer->GetID());
 
-	mPlayers.push_back(player);
+	return true;
+}
 
-	// Determine spawn position
-	float lane = LANE_TOP;
-	if (IsLaneOccupied(lane))
-		lane = LANE_BOTTOM;
+bool World::RemovePlayer(EntityID id)
+{
+	return mPlayers.erase(id);
+}
 
-	mPlayers.back().SetPosition({ SPAWN_POS_X, lane });
+void World::UpdateWorld(const World & other, bool complete, sf::Uint64 age)
+{
+	mPlayers = other.mPlayers;
 
-	return true;
+	if (complete)
+	{
+		mServerBullets = other.mBullets;
+		mServerBulletChecksum = other.mBulletChecksum;
+
+		// Any that left the screen before it was taken are of no use to later snapshots
+		mDepartedServerBullets.clear();
+
+		for (std::size_t i = 0; age > 0 && i < mServerBullets.size(); ++i)
+			mServerBullets.mutate(i).Update(age);
+
+		return;
+	}
+
+	// Merge the bullets the server chose to send, by id
+	for (std::size_t i = 0; i < other.mBullets.size(); ++i)
+	{
+		Bullet bullet = other.mBullets[i];
+		bullet.Update(age);
+
+		int j = mServerBullets.find(bullet.GetID());
+
+		if (j >= 0)
+		{
+			mServerBulletChecksum.Remove(mServerBullets, mServerBullets[j]);
+			mServerBullets.mutate(j) = bullet;
+		}
+		else
+		{
+			mServerBullets.insert_existing(bullet);
+			mDepartedServerBullets.erase(bullet.GetID());
+		}
+
+		mServerBulletChecksum.Add(mServerBullets, bullet);
+	}
 }
 
-bool World::RemovePlayer(sf::Uint8 id)
+World World::WithBullets(const std::vector<std::size_t>& indices) const
 {
-	auto hasPID = [id](const auto& player) { return player.GetID() == id; };
+	World world;
+	world.mPlayers = mPlayers;
 
-	auto it = mPlayers.erase(std::remove_if(mPlayers.begin(), mPlayers.end(), hasPID));
-	return it != mPlayers.end();
+	world.mBullets.reserve(indices.size());
+	for (std::size_t i : indices)
+	{
+		world.mBullets.push_back_shared(mBullets, i);
+		world.mBulletChecksum.Add(world.mBullets, mBullets[i]);
+	}
+
+	return world;
 }
 
-void World::UpdateWorld(const World & other)
+World World::Blend(const World& previous, float alpha, EntityID player) const
 {
-	mPlayers = other.mPlayers;
-	mServerBullets = other.mBullets;
+	const auto lerp = [alpha](const Vector& from, const Vector& to)
+	{
+		return ToVector(ToFloat(from) + (ToFloat(to) - ToFloat(from)) * alpha);
+	};
+
+	const auto blend = [&](slot_map<Bullet>& bullets, const slot_map<Bullet>& previousBullets)
+	{
+		for (std::size_t i = 0; i < bullets.size(); ++i)
+		{
+			int j = previousBullets.find(bullets[i].GetID());
+			if (j >= 0)
+				bullets.mutate(i).SetPosition(lerp(previousBullets[j].GetPosition(), bullets[i].GetPosition()));
+		}
+	};
+
+	World world = *this;
+
+	int i = world.mPlayers.find(player);
+	int j = previous.mPlayers.find(player);
+	if (i >= 0 && j >= 0)
+		world.mPlayers.mutate(i).SetPosition(lerp(previous.mPlayers[j].GetPosition(), mPlayers[i].GetPosition()));
+
+	blend(world.mBullets, previous.mBullets);
+	blend(world.mServerBullets, previous.mServerBullets);
+	blend(world.mPredictedBullets, previous.mPredictedBullets);
+
+	return world;
+}
+
+void World::RestoreIdState(const IdState& ids)
+{
+	mPlayers.restore_generations(ids.players);
+	mBullets.restore_generations(ids.bullets);
 }
 
-void World::RunCommand(const Command& cmd, sf::Uint8 id, bool rec)
+void World::RunCommand(const Command& cmd, EntityID id, bool rec)
 {
 	Player* player = GetPlayer(id);
 
@@ -94,136 +158,208 @@ void World::RunCommand(const Command& cmd, sf::Uint8 id, bool rec)
 		player->RunCommand(cmd, rec);
 
 		// Bound checking
-		if (player->GetPosition().x - H_PADDLE_W < 0.f)
-			player->SetX(H_PADDLE_W);
-		if (player->GetPosition().x + H_PADDLE_W > VP_WIDTH)
-			player->SetX(VP_WIDTH - H_PADDLE_W);
+		if (player->GetPosition().x < MIN_PLAYER_X)
+			player->SetX(MIN_PLAYER_X);
+		if (player->GetPosition().x > MAX_PLAYER_X)
+			player->SetX(MAX_PLAYER_X);
 	}
 }
 
-Bullet World::PlayerShoot(sf::Uint8 id, sf::Vector2f playerPos)
+Bullet World::PlayerShoot(EntityID id, Vector playerPos)
 {
-	Player* player = GetPlayer(id);
-	if (!player)
+	Bullet newBullet;
+	if (!MakeShot(id, playerPos, newBullet))
 		return{};
 
+	const Bullet* added = mBullets.insert(newBullet);
+	if (!added)
+		return{};
+
+	mBulletChecksum.Add(mBullets, *added);
+	return *added;
+}
+
+Bullet World::PredictShot(EntityID id)
+{
 	Bullet newBullet;
-	newBullet.SetID(mNewEID++);
+	if (!MakeShot(id, INVALID_POS, newBullet))
+		return{};
+
+	const Bullet* added = mPredictedBullets.insert(newBullet);
+	return added ? *added : Bullet{};
+}
+
+bool World::ConfirmShot(EntityID predictedID, const Bullet& bullet)
+{
+	int index = mPredictedBullets.find(predictedID);
+	if (index < 0)
+		return false;
+
+	Bullet confirmed = bullet;
+	confirmed.SetPosition(mPredictedBullets[index].GetPosition());
+
+	mPredictedBullets.erase(predictedID);
+	mBulletChecksum.Add(mBullets, mBullets.insert_existing(confirmed));
+	return true;
+}
+
+bool World::MakeShot(EntityID id, Vector playerPos, Bullet& newBullet) const
+{
+	const Player* player = GetPlayer(id);
+	if (!player)
+		return false;
+
 	newBullet.SetColour(player->GetColour());
 
 	// If this player is on top, fire down and vice versa
-	float direction = IsPlayerTopLane(id) ? 1.f : -1.f;
-	newBullet.SetDirection({ 0.f, direction });
+	Scalar direction = IsPlayerTopLane(id) ? Scalar(1.f) : Scalar(-1.f);
+	newBullet.SetDirection({ Scalar(0.f), direction });
 
 	if (playerPos != INVALID_POS)
 	{
-		playerPos.y += 32.f * direction;
+		playerPos.y += SHOT_OFFSET * direction;
 		newBullet.SetPosition(playerPos);
 	}
 	else
 	{
 		auto newPos = player->GetPosition();
-		newPos.y += 32.f * direction;
+		newPos.y += SHOT_OFFSET * direction;
 		newBullet.SetPosition(newPos);
 	}
 
-	mBullets.push_back(newBullet);
-	return newBullet;
+	return true;
 }
 
-void World::Update(sf::Uint64 dt)
+sf::Uint32 World::GetServerBulletChecksumAt(sf::Uint64 age) const
 {
-	for (auto it = mBullets.begin(); it != mBullets.end(); )
+	if (age == 0)
+		return GetServerBulletChecksum();
+
+	sf::Uint32 sum = 0;
+	const auto add = [&](const Bullet& bullet)
 	{
-		Bullet& bullet = *it;
+		Scalar direction = bullet.GetDirection().y;
 
-		bullet.Update(dt);
+		Bullet then = bullet;
+		then.SetPosition(bullet.GetPosition() - bullet.GetDirection() * DistanceIn(Bullet::BULLET_SPEED, ms(age)));
 
-		float bulletTop = bullet.GetPosition().y + H_BULLET_H;
-		float bulletBot = bullet.GetPosition().y - H_BULLET_H;
+		// Not fired yet (a pixel either way is rounding)
+		if ((then.GetPosition().y - ShotY(direction)) * direction < Scalar(-1.f))
+			return;
 
-		// Bound checking
-		bool isOffScreen = false;
-		if (bulletTop < 0.f || bulletBot >= VP_HEIGHT)
-			isOffScreen = true;
+		if (!IsOffScreen(then))
+			sum += bullet.GetChecksum();
+	};
 
-		if (isOffScreen)
-			it = mBullets.erase(it);
-		else
-			++it;
-	}
+	for (const auto& bullet : mServerBullets)
+		add(bullet);
+	for (const auto& bullet : mDepartedServerBullets)
+		add(bullet);
+
+	return sum;
 }
 
-Bullet* World::GetBullet(sf::Uint32 id)
+bool World::IsOffScreen(const Bullet& bullet)
 {
-	for (auto& bullet : mBullets)
-		if (bullet.GetID() == id)
-			return &bullet;
-
-	return nullptr;
+	// Entirely off the top or the bottom of the screen
+	return bullet.GetPosition().y < MIN_BULLET_Y || bullet.GetPosition().y >= MAX_BULLET_Y;
 }
 
-bool World::IsPlayerTopLane(sf::Uint8 id)
+Scalar World::ShotY(Scalar direction)
 {
-	Player* player = GetPlayer(id);
-	if (!player)
-		return false;
-
-	return player->GetPosition().y == LANE_TOP;
+	return (direction > Scalar(0.f) ? LANE_TOP : LANE_BOTTOM) + SHOT_OFFSET * direction;
 }
 
-Player* World::GetPlayer(sf::Uint8 id)
+void World::Update(sf::Uint64 dt)
 {
-	for (auto& player : mPlayers)
+	// Removes the bullets that have left the screen, and takes them out of the checksum
+	const auto removeOffScreen = [&](slot_map<Bullet>& bullets, BulletChecksum& checksum, slot_map<Bullet>* departed)
 	{
-		if (player.GetID() == id)
-			return &player;
-	}
+		bullets.remove_if([&](const Bullet& bullet)
+		{
+			if (!IsOffScreen(bullet))
+				return false;
+
+			checksum.Remove(bullets, bullet);
+			if (departed)
+				departed->insert_existing(bullet);
+
+			return true;
+		});
+	};
+
+	// Every bullet moves, so each one gets detached from the snapshots that share it
+	for (std::size_t i = 0; i < mBullets.size(); ++i)
+		mBullets.mutate(i).Update(dt);
 
-	return nullptr;
+	// Bound checking
+	removeOffScreen(mBullets, mBulletChecksum, nullptr);
+
+	// Server bullets are only refreshed every now and then when snapshots are partial,
+	// so move them along in between (this is empty on the server)
+	for (std::size_t i = 0; i < mServerBullets.size(); ++i)
+		mServerBullets.mutate(i).Update(dt);
+
+	// (those that left already are moved along first, so the ones leaving now are not moved twice)
+	for (std::size_t i = 0; i < mDepartedServerBullets.size(); ++i)
+		mDepartedServerBullets.mutate(i).Update(dt);
+
+	mDepartedServerBullets.remove_if([](const Bullet& bullet)
+	{
+		return bullet.GetPosition().y < MIN_BULLET_Y - MAX_DEPARTED_DISTANCE || bullet.GetPosition().y >= MAX_BULLET_Y + MAX_DEPARTED_DISTANCE;
+	});
+
+	removeOffScreen(mServerBullets, mServerBulletChecksum, &mDepartedServerBullets);
+
+	for (std::size_t i = 0; i < mPredictedBullets.size(); ++i)
+		mPredictedBullets.mutate(i).Update(dt);
+
+	mPredictedBullets.remove_if(IsOffScreen);
 }
 
-bool World::PlayerExists(sf::Uint8 id)
+Bullet* World::GetBullet(EntityID id)
 {
-	return GetPlayer(id) != nullptr;
+	int index = mBullets.find(id);
+	return (index >= 0) ? &mBullets.mutate(index) : nullptr;
 }
 
-sf::Uint8 World::GeneratePlayerID()
+const Bullet* World::GetBullet(EntityID id) const
 {
-	return mNewPID++;
+	int index = mBullets.find(id);
+	return (index >= 0) ? &mBullets[index] : nullptr;
 }
 
-bool World::IsLaneOccupied(int lane) const
+bool World::IsPlayerTopLane(EntityID id) const
 {
-	for (const auto& player : mPlayers)
-		if (player.GetPosition().y == lane)
-			return true;
+	const Player* player = GetPlayer(id);
+	if (!player)
+		return false;
 
-	return false;
+	return player->GetPosition().y == LANE_TOP;
 }
 
-sf::Packet& operator<<(sf::Packet& p, const World& world)
+Player* World::GetPlayer(EntityID id)
 {
-	p << world.mPlayers << world.mBullets;
-
-	return p;
+	int index = mPlayers.find(id);
+	return (index >= 0) ? &mPlayers.mutate(index) : nullptr;
 }
 
-sf::Packet& operator >> (sf::Packet& p, World& world)
+const Player* World::GetPlayer(EntityID id) const
 {
-	p >> world.mPlayers >> world.mBullets;
-
-	return p;
+	int index = mPlayers.find(id);
+	return (index >= 0) ? &mPlayers[index] : nullptr;
 }
 
-sf::Packet& operator<<(sf::Packet& p, const WorldSnapshot& snapshot)
+bool World::PlayerExists(EntityID id) const
 {
-	p << snapshot.snapshot << snapshot.serverTime << snapshot.clientTime;
-	return p;
+	return GetPlayer(id) != nullptr;
 }
 
-sf::Packet& operator >> (sf::Packet& p, WorldSnapshot& snapshot)
+bool World::IsLaneOccupied(Scalar lane) const
 {
-	p >> snapshot.snapshot >> snapshot.serverTime << snapshot.clientTime;
-	return p;
+	for (const auto& player : mPlayers)
+		if (player.GetPosition().y == lane)
+			return true;
+
+	return false;
 }
@@ -2,73 +2,169 @@
 #include "player.h"
 #include "bullet.h"
 #include "common.h"
+#include "cow_vector.h"
+#include "slot_map.h"
 #include <vector>
-#include <SFML/Graphics.hpp>
+#include <SFML/System.hpp>
 
 // world.h: Represents a game simulation. Holds the position of all the entities in the game
 //			Also contains movement constraints
+//			Entities are copy-on-write, so copying a World (taking a snapshot) is O(1)
 
 class World
 {
 public:
-	friend sf::Packet& operator<<(sf::Packet& p, const World& world);
-	friend sf::Packet& operator >> (sf::Packet& p, World& world);
-
 	static constexpr int MAX_PLAYERS = 2;
 
-	static constexpr float LANE_BOTTOM = VP_HEIGHT - 12.f;
-	static constexpr float LANE_TOP = 12.f;
-
-	static const sf::Vector2f INVALID_POS;
+	static constexpr Scalar LANE_BOTTOM{ VP_HEIGHT - 12.f };
+	static constexpr Scalar LANE_TOP{ 12.f };
 
-	static void RenderWorld(const World& world, sf::RenderWindow& window, bool showServerBullets = false);
+	static const Vector INVALID_POS;
 
 	void AddBullet(const Bullet& bullet);
 
+	void RemoveBullet(EntityID id);
+
+	// Gives the player an id and a place in the game
 	bool AddPlayer(Player& player);
-	bool RemovePlayer(sf::Uint8 id);
+	bool RemovePlayer(EntityID id);
+
+	// Replaces every player (used when playing back recordings)
+	void SetPlayers(const cow_vector<Player>& players) { mPlayers.assign(players); }
 
-	void UpdateWorld(const World& other);
+	// Takes the players and bullets from a server snapshot
+	// complete: false if the snapshot only holds some of the server's bullets; the others are left as they are
+	// age: How long ago (ms) the snapshot was taken; the bullets it brings are moved along to now, like the others
+	void UpdateWorld(const World& other, bool complete = true, sf::Uint64 age = 0);
 
-	void RunCommand(const Command& cmd, sf::Uint8 id, bool rec);
-	Bullet PlayerShoot(sf::Uint8 id, sf::Vector2f playerPos = INVALID_POS);
+	// Copy of this world holding only the given bullets (entities are shared, not duplicated)
+	World WithBullets(const std::vector<std::size_t>& indices) const;
+
+	// Client-side: Copy of this world 'alpha' (0 to 1) of the way to it from 'previous', the world one step earlier
+	// Only the given player and the bullets are blended
+	World Blend(const World& previous, float alpha, EntityID player) const;
+
+	void RunCommand(const Command& cmd, EntityID id, bool rec);
+	Bullet PlayerShoot(EntityID id, Vector playerPos = INVALID_POS);
+
+	// Client-side: Fires a bullet ahead of the server, kept apart from the others until the server's copy replaces it
+	Bullet PredictShot(EntityID id);
+	// Returns false if the predicted bullet is gone already
+	bool ConfirmShot(EntityID predictedID, const Bullet& bullet);
 
 	void Update(sf::Uint64 dt);
 
-	Bullet* GetBullet(sf::Uint32 id);
+	// NOTE: The non-const getters detach the entity from any snapshot sharing it,
+	//		 prefer the const versions when only reading
+	Bullet* GetBullet(EntityID id);
+	const Bullet* GetBullet(EntityID id) const;
 
-	bool IsPlayerTopLane(sf::Uint8 id);
-	Player* GetPlayer(sf::Uint8 id);
-	bool PlayerExists(sf::Uint8 id);
+	bool IsPlayerTopLane(EntityID id) const;
+	Player* GetPlayer(EntityID id);
+	const Player* GetPlayer(EntityID id) const;
+	bool PlayerExists(EntityID id) const;
 
-	const std::vector<Bullet>& GetBullets() const { return mBullets; }
-	const std::vector<Player>& GetPlayers() const { return mPlayers; }
+	const cow_vector<Bullet>& GetBullets() const { return mBullets.elements(); }
+	const cow_vector<Player>& GetPlayers() const { return mPlayers.elements(); }
+	// Client-side: The server's bullets as of its last snapshot, before any prediction (for debugging)
+	const cow_vector<Bullet>& GetServerBullets() const { return mServerBullets.elements(); }
+	// Client-side: Bullets we fired that the server has not confirmed yet
+	const cow_vector<Bullet>& GetPredictedBullets() const { return mPredictedBullets.elements(); }
 
-private:
-	static constexpr float SPAWN_POS_X = H_VP_WIDTH;
+	// Client-side: A bullet the server has told us it spawned, so the server's bullets are known without waiting for a snapshot
+	void AddServerBullet(const Bullet& bullet);
 
-	sf::Uint8 GeneratePlayerID();
-	bool IsLaneOccupied(int lane) const;
+	// Checksums of which bullets exist: the world's own, and client-side, the server's as far as we know
+	sf::Uint32 GetBulletChecksum() const { return mBulletChecksum.Get(mBullets); }
+	sf::Uint32 GetServerBulletChecksum() const { return mServerBulletChecksum.Get(mServerBullets); }
+	// Client-side: The server's bullets as they were 'age' ms ago (O(n))
+	sf::Uint32 GetServerBulletChecksumAt(sf::Uint64 age) const;
 
-	// Player ID
-	sf::Uint8 mNewPID = 1;
-	// Entity ID (bullets)
-	sf::Uint32 mNewEID = 1;
+	// Wire layout (protocol.h)
+	static constexpr auto Fields() { return std::make_tuple(&World::mPlayers, &World::mBullets); }
 
-	std::vector<Player> mPlayers;
-	std::vector<Bullet> mBullets;
-	std::vector<Bullet> mServerBullets;
-};
+	// What a server needs besides the wire layout to carry on handing out ids
+	struct IdState
+	{
+		std::vector<sf::Uint16> players;
+		std::vector<sf::Uint16> bullets;
+
+		static constexpr auto Fields() { return std::make_tuple(&IdState::players, &IdState::bullets); }
+	};
 
-sf::Packet& operator<<(sf::Packet& p, const World& world);
-sf::Packet& operator >> (sf::Packet& p, World& world);
+	IdState GetIdState() const { return { mPlayers.generations(), mBullets.generations() }; }
+	void RestoreIdState(const IdState& ids);
+
+private:
+	static constexpr Scalar SPAWN_POS_X{ H_VP_WIDTH };
+
+	// Where the players' and bullets' bounds are, in the simulation's own numbers
+	static constexpr Scalar MIN_PLAYER_X{ H_PADDLE_W };
+	static constexpr Scalar MAX_PLAYER_X{ VP_WIDTH - H_PADDLE_W };
+	static constexpr Scalar MIN_BULLET_Y{ -H_BULLET_H };
+	static constexpr Scalar MAX_BULLET_Y{ VP_HEIGHT + H_BULLET_H };
+
+	// How far in front of the player a bullet is fired from
+	static constexpr Scalar SHOT_OFFSET{ 32.f };
+
+	// How far past the screen the server's bullets are kept, for GetServerBulletChecksumAt
+	static constexpr Scalar MAX_DEPARTED_DISTANCE = Bullet::BULLET_SPEED;
+
+	static bool IsOffScreen(const Bullet& bullet);
+	// Where a bullet going this way is fired from
+	static Scalar ShotY(Scalar direction);
+
+	bool IsLaneOccupied(Scalar lane) const;
+
+	// The bullet a player fires, without an id yet; false if there is no such player
+	bool MakeShot(EntityID id, Vector playerPos, Bullet& bullet) const;
+
+	// Sum of the bullets' checksums, kept up to date as bullets come and go; worked out again after they are replaced at once
+	class BulletChecksum
+	{
+	public:
+		void Add(const slot_map<Bullet>& bullets, const Bullet& bullet) { if (IsKnown(bullets)) mSum += bullet.GetChecksum(); }
+		void Remove(const slot_map<Bullet>& bullets, const Bullet& bullet) { if (IsKnown(bullets)) mSum -= bullet.GetChecksum(); }
+
+		sf::Uint32 Get(const slot_map<Bullet>& bullets) const
+		{
+			if (!IsKnown(bullets))
+			{
+				mSum = 0;
+				for (const auto& bullet : bullets)
+					mSum += bullet.GetChecksum();
+
+				mAssignments = bullets.assignments();
+			}
+
+			return mSum;
+		}
+
+	private:
+		bool IsKnown(const slot_map<Bullet>& bullets) const { return mAssignments == bullets.assignments(); }
+
+		mutable sf::Uint32 mSum = 0;
+		// The slot_map's assignments() the sum was worked out for
+		mutable sf::Uint32 mAssignments = 0;
+	};
+
+	slot_map<Player> mPlayers;
+	slot_map<Bullet> mBullets;
+	slot_map<Bullet> mServerBullets;
+	slot_map<Bullet> mPredictedBullets;
+	// Client-side: The server's bullets that have left the screen recently
+	slot_map<Bullet> mDepartedServerBullets;
+
+	BulletChecksum mBulletChecksum;
+	BulletChecksum mServerBulletChecksum;
+};
 
 struct WorldSnapshot
 {
 	World snapshot;
+	// Microseconds on the server's clock
 	sf::Uint64 serverTime = 0;
-	sf::Uint64 clientTime = 0;
-};
 
-sf::Packet& operator<<(sf::Packet& p, const WorldSnapshot& snapshot);
-sf::Packet& operator >> (sf::Packet& p, WorldSnapshot& snapshot);
+	// Wire layout (protocol.h)
+	static constexpr auto Fields() { return std::make_tuple(&WorldSnapshot::snapshot, &WorldSnapshot::serverTime); }
+};